@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#include <chrono>
+#include <string>
+
+/* Milliseconds elapsed since @start. */
+static inline double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Run @body until it took at least @min_ms in total (and at least once). Returns the average milliseconds of a run. */
+template <typename Body>
+double time_runs(Body body, double min_ms = 500) {
+    int runs = 0;
+    auto start = std::chrono::steady_clock::now();
+    do {
+        body();
+        runs++;
+    } while (elapsed_ms(start) < min_ms);
+    return elapsed_ms(start) / runs;
+}
+
+/* A text of @size characters that differs with @seed, so the values are not all equal. */
+static inline std::string sample_text(size_t size, unsigned int seed) {
+    static const char ALPHABET[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_";
+    std::string text;
+    text.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        text += ALPHABET[(seed >> 16) % (sizeof(ALPHABET) - 1)];
+    }
+    return text;
+}
+
+/* A search entry as printed by PRINT_SEARCH_METADATA_JSON_TEMPLATE, and by PRINT_SEARCH_METADATA_TEMPLATE. */
+static inline void sample_search_entry(int i, std::string& json_line, std::string& text_line) {
+    std::string id = sample_text(11, i);
+    std::string title = "Video " + std::to_string(i) + " " + sample_text(40 + i % 40, i + 1);
+    std::string thumbnail = "https://i.ytimg.com/vi/" + id + "/mqdefault.jpg";
+    std::string creator = "Channel " + sample_text(12, i + 2);
+    std::string channel_id = "UC" + sample_text(22, i + 3);
+    std::string duration = std::to_string(60 + i % 3600);
+    std::string views = std::to_string(1000 + i * 37);
+    json_line = "{\"title\":\"" + title + " \\\"live\\\" \\u00e9\",\"thumbnail\":\"" + thumbnail + "\",\"creators\":\"" + creator
+        + "\",\"video_id\":\"" + id + "\",\"upload_date\":\"2025-03-14\",\"duration\":" + duration + ",\"channel_id\":\""
+        + channel_id + "\",\"live_status\":\"not_live\",\"viewers_count\":" + views + "}";
+    text_line = "title=\"" + title + " \"live\" \xc3\xa9\">>thumbnail=\"" + thumbnail + "\">>creators=\"" + creator + "\">>video_id=\""
+        + id + "\">>upload_date=\"2025-03-14\">>duration=\"" + duration + "\">>channel_id=\"" + channel_id
+        + "\">>live_status=\"not_live\">>viewers_count=\"" + views + "\">>";
+}
+
+#endif
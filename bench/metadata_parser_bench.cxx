@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Parse throughput of the search metadata printed by yt-dlp: the JSON parser (METADATA_OUTPUT_FORMAT = JSON) against
+ * the key="value">> text parser, for the same 1,000 entries.
+ */
+
+#include "../include/ytdlp_helper.h"
+#include "bench_utils.h"
+#include <cstdio>
+#include <vector>
+
+static const int ENTRIES_COUNT = 1000;
+
+int main() {
+    std::vector<std::string> json_lines(ENTRIES_COUNT), text_lines(ENTRIES_COUNT);
+    size_t json_bytes = 0, text_bytes = 0;
+    for (int i = 0; i < ENTRIES_COUNT; i++) {
+        sample_search_entry(i, json_lines[i], text_lines[i]);
+        json_bytes += json_lines[i].size();
+        text_bytes += text_lines[i].size();
+    }
+
+    // Both parsers must read the same values.
+    for (int i = 0; i < ENTRIES_COUNT; i++) {
+        YTDLP_Video_Metadata from_json, from_text;
+        if (!YtDlp_Helper::parse_json_metadata(json_lines[i], from_json)) {
+            fprintf(stderr, "Entry %d is not valid JSON.\n", i);
+            return 1;
+        }
+        YtDlp_Helper::parse_metadata(text_lines[i], from_text);
+        if (from_json.id != from_text.id || from_json.title != from_text.title || from_json.viewers_count != from_text.viewers_count
+                || from_json.duration != from_text.duration || from_json.live_status != from_text.live_status) {
+            fprintf(stderr, "Entry %d is parsed differently by the JSON and the text parsers.\n", i);
+            return 1;
+        }
+    }
+
+    double json_ms = time_runs([&]() {
+        for (const std::string& line: json_lines) {
+            YTDLP_Video_Metadata metadata;
+            YtDlp_Helper::parse_json_metadata(line, metadata);
+        }
+    });
+    double text_ms = time_runs([&]() {
+        for (const std::string& line: text_lines) {
+            YTDLP_Video_Metadata metadata;
+            YtDlp_Helper::parse_metadata(line, metadata);
+        }
+    });
+
+    printf("Metadata parse time per %d search entries:\n", ENTRIES_COUNT);
+    printf("  JSON parser:  %8.3f ms (%6.1f MB/s)\n", json_ms, json_bytes / 1024.0 / 1024.0 / (json_ms / 1000));
+    printf("  text parser:  %8.3f ms (%6.1f MB/s)\n", text_ms, text_bytes / 1024.0 / 1024.0 / (text_ms / 1000));
+    printf("  JSON parser is %.2fx the speed of the text parser.\n", text_ms / json_ms);
+    return 0;
+}
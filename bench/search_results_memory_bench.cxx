@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Memory footprint of 10k cached search results: the typed records allocated by batch at @Search_Results, against the
+ * previous record (every field as a std::string, one allocation by record).
+ */
+
+#include "../include/ytdlp_helper.h"
+#include "bench_utils.h"
+#include <cstdio>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static const int RESULTS_COUNT = 10000;
+/* Records by search batch, as loaded by YtDlp_Helper (PREFETCH_BATCH_RESULTS_SIZE). */
+static const int BATCH_SIZE = 40;
+
+/* The video metadata record before the numeric fields were parsed once. */
+struct Text_Video_Metadata {
+    std::string id;
+    std::string title;
+    std::string url;
+    std::string upload_date;
+    std::string creators;
+    std::string duration;
+    std::string channel_id;
+    std::string thumbnail_url;
+    std::string live_status;
+    std::string viewers_count;
+    std::string description = "NA";
+    std::string like_count = "NA";
+    std::string channel_follower_count = "NA";
+    bool is_live = false;
+    std::string concurrent_viewers_count;
+    std::string timestamp = "NA";
+    std::string timestamp_text = "NA";
+    YT_VIDEO_TYPE media_type = YT_VIDEO_TYPE::UNKNONW;
+    std::string category = "NA";
+    std::vector<std::string> tags;
+};
+
+/* Same estimate than YTDLP_Video_Metadata::footprint(), for a @Text_Video_Metadata. */
+static size_t text_footprint(const Text_Video_Metadata& record) {
+    auto heap_size = [](const std::string& str) -> size_t {
+        return (str.capacity() > 15) ? str.capacity() + 1 : 0;
+    };
+    return sizeof(Text_Video_Metadata) + heap_size(record.id) + heap_size(record.title) + heap_size(record.url)
+        + heap_size(record.upload_date) + heap_size(record.creators) + heap_size(record.duration) + heap_size(record.channel_id)
+        + heap_size(record.thumbnail_url) + heap_size(record.live_status) + heap_size(record.viewers_count)
+        + heap_size(record.concurrent_viewers_count) + heap_size(record.timestamp_text);
+}
+
+/* Bytes allocated at the heap (as reported by the allocator), or 0 if unknown. */
+static size_t heap_in_use() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static void print_usage(const char* name, size_t heap_bytes, size_t estimated_bytes) {
+    printf("  %-26s footprint %8.1f KB (%4zu bytes by result)", name, estimated_bytes / 1024.0, estimated_bytes / RESULTS_COUNT);
+    if (heap_bytes > 0) printf(", allocated %8.1f KB", heap_bytes / 1024.0);
+    printf("\n");
+}
+
+int main() {
+    std::vector<std::string> json_lines(RESULTS_COUNT);
+    std::string text_line;
+    for (int i = 0; i < RESULTS_COUNT; i++) sample_search_entry(i, json_lines[i], text_line);
+
+    printf("Memory used by %d search results:\n", RESULTS_COUNT);
+    size_t typed_bytes, typed_heap_bytes;
+    {
+        size_t heap_before = heap_in_use();
+        Search_Results results;
+        for (int i = 0; i < RESULTS_COUNT; i++) {
+            if (i % BATCH_SIZE == 0) results.reserve_batch(BATCH_SIZE);
+            YTDLP_Video_Metadata metadata;
+            YtDlp_Helper::parse_json_metadata(json_lines[i], metadata);
+            results.append(std::move(metadata));
+        }
+        typed_heap_bytes = heap_in_use() - heap_before;
+        typed_bytes = results.footprint();
+        print_usage("typed records (arena)", typed_heap_bytes, typed_bytes);
+    }
+
+    size_t text_bytes = 0, text_heap_bytes;
+    {
+        size_t heap_before = heap_in_use();
+        std::vector<Text_Video_Metadata*> results;
+        for (int i = 0; i < RESULTS_COUNT; i++) {
+            YTDLP_Video_Metadata metadata;
+            YtDlp_Helper::parse_json_metadata(json_lines[i], metadata);
+            Text_Video_Metadata* record = new Text_Video_Metadata();
+            record->id = metadata.id;
+            record->title = metadata.title;
+            record->url = metadata.url;
+            record->upload_date = metadata.upload_date;
+            record->creators = metadata.creators;
+            record->duration = std::to_string(metadata.duration);
+            record->channel_id = metadata.channel_id;
+            record->thumbnail_url = metadata.thumbnail_url;
+            record->live_status = "not_live";
+            record->viewers_count = std::to_string(metadata.viewers_count);
+            results.push_back(record);
+        }
+        text_heap_bytes = heap_in_use() - heap_before;
+        text_bytes = sizeof(std::vector<Text_Video_Metadata*>) + results.capacity() * sizeof(Text_Video_Metadata*);
+        for (Text_Video_Metadata* record: results) text_bytes += text_footprint(*record);
+        print_usage("text records (one by one)", text_heap_bytes, text_bytes);
+        for (Text_Video_Metadata* record: results) delete record;
+    }
+    if (typed_heap_bytes > 0 && text_heap_bytes > 0) {
+        printf("  typed records allocate %.0f%% of the memory of the text records.\n", 100.0 * typed_heap_bytes / text_heap_bytes);
+    } else {
+        printf("  typed records use %.0f%% of the memory of the text records.\n", 100.0 * typed_bytes / text_bytes);
+    }
+    return 0;
+}
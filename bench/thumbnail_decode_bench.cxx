@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Thumbnail decode and resize times: create_resized_image_from_jpg() against the previous one (the whole JPEG decoded
+ * by FLTK and resized with Fl_Image::copy()), for the thumbnails at a directory (argument 1, by default the thumbnails
+ * saved by FLTube), at the widths shown by FLTube. The resize alone is also timed on a synthetic 320x180 image.
+ */
+
+#include "../include/fltube_utils.h"
+#include "../include/thumbnail_decoder.h"
+#include "bench_utils.h"
+#include <FL/Fl_JPEG_Image.H>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+/* Widths of the thumbnails at the search results and at the video information window. */
+static const int TARGET_WIDTHS[] = { 95, 330 };
+
+/* create_resized_image_from_jpg() before the thumbnails were decoded near their target size. */
+static Fl_Image* baseline_resized_image_from_jpg(const std::string& jpg_filepath, int target_width) {
+    Fl_Image* original_image = new Fl_JPEG_Image(jpg_filepath.c_str());
+    int new_height = ceil((original_image->h() / static_cast<double>(original_image->w())) * target_width);
+    Fl_Image* resized_image = original_image->copy(target_width, new_height);
+    delete original_image;
+    return resized_image;
+}
+
+int main(int argc, char* argv[]) {
+    std::string thumbnails_dir = (argc > 1) ? argv[1] : std::string(getenv("HOME") ? getenv("HOME") : "") + "/.cache/fltube/thumbnails";
+    std::vector<std::string> thumbnails;
+    std::error_code error;
+    for (const std::filesystem::directory_entry& file: std::filesystem::directory_iterator(thumbnails_dir, error)) {
+        if (!file.is_regular_file()) continue;
+        // Only the files FLTK can decode (i.e. not the index of the thumbnail store).
+        Fl_JPEG_Image image(file.path().c_str());
+        if (image.fail() == 0 && image.w() > 0) thumbnails.push_back(file.path().string());
+    }
+
+    if (thumbnails.empty()) {
+        printf("No JPEG thumbnails found at %s (pass a directory with JPEG files as argument): skipping the decode times.\n",
+               thumbnails_dir.c_str());
+    } else {
+        printf("Thumbnail decode and resize (%zu thumbnails at %s):\n", thumbnails.size(), thumbnails_dir.c_str());
+        for (int target_width: TARGET_WIDTHS) {
+            double baseline_ms = time_runs([&]() {
+                for (const std::string& path: thumbnails) delete baseline_resized_image_from_jpg(path, target_width);
+            });
+            double current_ms = time_runs([&]() {
+                for (const std::string& path: thumbnails) delete create_resized_image_from_jpg(path, target_width);
+            });
+            printf("  width %3d: Fl_JPEG_Image + copy() %8.3f ms, create_resized_image_from_jpg() %8.3f ms by thumbnail (%.2fx)\n",
+                   target_width, baseline_ms / thumbnails.size(), current_ms / thumbnails.size(), baseline_ms / current_ms);
+        }
+    }
+
+    // A 320x180 image (as "mqdefault.jpg") with a gradient and some noise.
+    const int source_w = 320, source_h = 180, depth = 3;
+    std::vector<unsigned char> pixels(source_w * source_h * depth);
+    unsigned int seed = 1;
+    for (size_t i = 0; i < pixels.size(); i++) {
+        seed = seed * 1103515245 + 12345;
+        pixels[i] = static_cast<unsigned char>(((i % (source_w * depth)) * 255 / (source_w * depth)) ^ ((seed >> 16) & 0x1f));
+    }
+    Fl_RGB_Image source(pixels.data(), source_w, source_h, depth);
+    printf("Resize of a %dx%d image:\n", source_w, source_h);
+    for (int target_width: TARGET_WIDTHS) {
+        // Enlargements are still made by Fl_Image::copy().
+        if (target_width >= source_w) continue;
+        int target_height = ceil((source_h / static_cast<double>(source_w)) * target_width);
+        std::vector<unsigned char> target(target_width * target_height * depth);
+        double copy_ms = time_runs([&]() { delete source.copy(target_width, target_height); });
+        double average_ms = time_runs([&]() {
+            resize_area_average(pixels.data(), source_w, source_h, source_w * depth, depth, target.data(), target_width, target_height);
+        });
+        printf("  width %3d: Fl_RGB_Image::copy() %8.2f us, resize_area_average() %8.2f us (%.2fx)\n",
+               target_width, copy_ms * 1000, average_ms * 1000, copy_ms / average_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Stress of the URL cache from several threads: lookup throughput with 1, 2 and 4 threads, while every thread also adds
+ * (replaces) an entry every @WRITE_EVERY operations, as the stream and the stream URL prefetch do.
+ */
+
+#include "../include/cache.h"
+#include "bench_utils.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static const int ENTRIES_COUNT = 1000;
+static const int WRITE_EVERY = 100;
+static const int RUN_MS = 1000;
+
+int main() {
+    std::shared_ptr<TerminalLogger> logger = std::make_shared<TerminalLogger>(false);
+    URLCache cache(logger);
+    // Without capacity limits, so no lookup misses because of the uneven distribution of the entries by shard.
+    cache.set_capacity(0, 0);
+    std::vector<std::string> ids;
+    for (int i = 0; i < ENTRIES_COUNT; i++) {
+        ids.push_back("https://www.youtube.com/watch?v=" + sample_text(11, i) + ":360");
+        cache.add_entry(ids.back(), "https://rr1---sn-example.googlevideo.com/videoplayback?" + sample_text(900, i));
+    }
+
+    printf("URL cache lookups (%d entries, a write every %d operations, %u CPUs):\n", ENTRIES_COUNT, WRITE_EVERY,
+           std::thread::hardware_concurrency());
+    double single_thread_rate = 0;
+    for (int threads_count: { 1, 2, 4 }) {
+        std::atomic<bool> stop(false);
+        std::atomic<unsigned long> total_lookups(0), total_misses(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < threads_count; t++) {
+            threads.emplace_back([&, t]() {
+                unsigned long lookups = 0, misses = 0;
+                unsigned int seed = t + 1;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    seed = seed * 1103515245 + 12345;
+                    const std::string& id = ids[(seed >> 8) % ids.size()];
+                    if (lookups % WRITE_EVERY == 0) {
+                        cache.add_entry(id, "https://rr2---sn-example.googlevideo.com/videoplayback?" + sample_text(900, seed));
+                    }
+                    if (!cache.lookup(id).found) misses++;
+                    lookups++;
+                }
+                total_lookups += lookups;
+                total_misses += misses;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MS));
+        stop.store(true);
+        for (std::thread& thread: threads) thread.join();
+
+        double rate = total_lookups.load() / (RUN_MS / 1000.0);
+        if (threads_count == 1) single_thread_rate = rate;
+        printf("  %d thread(s): %10.0f lookups/s (%.2fx of 1 thread)%s\n", threads_count, rate, rate / single_thread_rate,
+               total_misses.load() > 0 ? " - UNEXPECTED MISSES" : "");
+        if (total_misses.load() > 0) return 1;
+    }
+    printf("  %s\n", format_cache_stats("URL cache", cache.get_stats()).c_str());
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Load and save times of the permanent URL cache with 1k, 10k and 100k entries: the journal (a record appended by
+ * change) against the text snapshot (the whole file rewritten, as every save did before the journal), and the binary
+ * snapshot.
+ */
+
+#include "../include/cache.h"
+#include "bench_utils.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+
+static const size_t VALUE_SIZE = 1000;
+
+/* Exposes load() and save(), that the application only calls through init() and finish(). */
+class Bench_Disk_Cache: public PermanentDiskCache {
+public:
+    using PermanentDiskCache::PermanentDiskCache;
+    using PermanentDiskCache::load;
+    using PermanentDiskCache::save;
+};
+
+/* A cache saved at @dirname, without capacity limits. An empty snapshot is created if none exists, so no warning is
+ * printed by the first load. */
+static std::unique_ptr<Bench_Disk_Cache> open_cache(const std::string& dirname, CACHE_FILE_FORMAT format) {
+    std::unique_ptr<Bench_Disk_Cache> cache = std::make_unique<Bench_Disk_Cache>(std::make_shared<TerminalLogger>(false));
+    cache->set_capacity(0, 0);
+    std::filesystem::create_directories(dirname);
+    cache->set_save_directory_path(dirname, "cache.txt");
+    cache->set_file_format(format);
+    if (!std::filesystem::exists(dirname + "/cache.txt") && !std::filesystem::exists(dirname + "/cache.bin")) {
+        std::ofstream(dirname + "/cache.txt");
+    }
+    return cache;
+}
+
+static std::string sample_id(size_t i) {
+    return "https://www.youtube.com/watch?v=" + sample_text(11, i) + ":" + std::to_string(i);
+}
+
+static std::string sample_value(size_t i) {
+    return "https://rr1---sn-example.googlevideo.com/videoplayback?" + sample_text(VALUE_SIZE, i);
+}
+
+static void print_time(const char* name, double ms, size_t entries_count) {
+    printf("    %-34s %10.2f ms (%7.2f us by entry)\n", name, ms, ms * 1000 / entries_count);
+}
+
+int main() {
+    std::string bench_dir = (std::filesystem::temp_directory_path() / ("fltube_cache_bench_" + std::to_string(getpid()))).string();
+    printf("Permanent URL cache persistence (values of %zu bytes, files at %s):\n", VALUE_SIZE, bench_dir.c_str());
+    for (size_t entries_count: { 1000, 10000, 100000 }) {
+        printf("  %zu entries:\n", entries_count);
+        std::vector<std::string> ids, values;
+        for (size_t i = 0; i < entries_count; i++) {
+            ids.push_back(sample_id(i));
+            values.push_back(sample_value(i));
+        }
+        std::string journal_dir = bench_dir + "/journal", text_dir = bench_dir + "/text", binary_dir = bench_dir + "/binary";
+
+        // Save: every entry added is appended to the journal, while a snapshot rewrites every entry.
+        double journal_ms, text_save_ms, binary_save_ms;
+        {
+            std::unique_ptr<Bench_Disk_Cache> cache = open_cache(journal_dir, TEXT_FORMAT);
+            cache->load();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < entries_count; i++) cache->add_entry(ids[i], values[i]);
+            journal_ms = elapsed_ms(start);
+            // The journal is left as written by a session killed before finish().
+        }
+        {
+            // Not loaded, so the journal is not opened while the entries are added.
+            std::unique_ptr<Bench_Disk_Cache> cache = open_cache(text_dir, TEXT_FORMAT);
+            for (size_t i = 0; i < entries_count; i++) cache->add_entry(ids[i], values[i]);
+            text_save_ms = time_runs([&]() { cache->save(); }, 0);
+            cache->set_file_format(BINARY_FORMAT);
+            std::filesystem::create_directories(binary_dir);
+            cache->set_save_directory_path(binary_dir, "cache.txt");
+            binary_save_ms = time_runs([&]() { cache->save(); }, 0);
+        }
+        print_time("journal (all entries appended)", journal_ms, entries_count);
+        print_time("text snapshot (save)", text_save_ms, entries_count);
+        print_time("binary snapshot (save)", binary_save_ms, entries_count);
+        printf("    a change costs %.2f us with the journal, and %.2f ms rewriting the text snapshot.\n",
+               journal_ms * 1000 / entries_count, text_save_ms);
+
+        // Load: the journal is replayed and then compacted to a snapshot, while a binary snapshot is only mapped.
+        auto time_load = [&](const std::string& dirname, CACHE_FILE_FORMAT format) -> double {
+            std::unique_ptr<Bench_Disk_Cache> cache = open_cache(dirname, format);
+            auto start = std::chrono::steady_clock::now();
+            cache->load();
+            double ms = elapsed_ms(start);
+            if (cache->get_entry_value(ids.back()) != values.back()) {
+                fprintf(stderr, "The cache loaded from %s lost its entries.\n", dirname.c_str());
+                exit(1);
+            }
+            return ms;
+        };
+        print_time("journal replay (and compaction)", time_load(journal_dir, TEXT_FORMAT), entries_count);
+        print_time("text snapshot (load)", time_load(text_dir, TEXT_FORMAT), entries_count);
+        print_time("binary snapshot (load, mapped)", time_load(binary_dir, BINARY_FORMAT), entries_count);
+
+        std::filesystem::remove_all(bench_dir);
+    }
+    return 0;
+}
@@ -14,6 +14,7 @@
 #define FLTUBE_H
 
 #include "FLTube_View.h"
+#include "cache.h"
 #include <FL/Fl_File_Chooser.H>
 #include <FL/Enumerations.H>
 #include <FL/Fl_Button.H>
@@ -40,6 +41,13 @@
  */
 static const char* VERSION = VERSION_STRING;
 
+/* Policy of the decoded thumbnails cache: images never expire, and their size is the size of their pixels. */
+struct Decoded_Thumbnail_Policy: Default_Cache_Policy<std::string, std::shared_ptr<Fl_Image>> {
+    static size_t footprint(const std::string& key, const std::shared_ptr<Fl_Image>& image) {
+        return key.capacity() + sizeof(Fl_RGB_Image) + static_cast<size_t>(image->w()) * image->h() * std::max(1, image->d());
+    }
+};
+
 /**  Save this object as user_data in buttons callbacks for Video Info. */
 struct DownloadVideoCBData {
     int video_resolution;
@@ -49,12 +57,20 @@ struct DownloadVideoCBData {
 void exitApp(unsigned short int exitStatusCode);
 static void closeWindow_cb(Fl_Widget*, Fl_Window *targetWindow);
 static void showMessageWindow(const char* message, const char *title = nullptr);
+static std::string cache_stats_report();
 static void lock_buttons(bool lock);
 static void preview_video_cb(Fl_Button* widget, void* video_url);
 static void add_video_group(int posx, int posy);
 static VideoInfo* create_video_group(int posx, int posy);
 static void clear_video_info();
 static void update_video_info();
+static void set_thumbnail_image(size_t slot, std::shared_ptr<Fl_Image> image);
+static std::shared_ptr<Fl_Image> get_decoded_thumbnail(const std::string& video_id, const std::string& thumbn_path, int width,
+                                                       const std::string* thumbn_data = nullptr);
+static void forget_decoded_thumbnail(const std::string& video_id);
+static void show_thumbnail(size_t slot, const std::string& thumbn_path, const std::string* thumbn_data = nullptr);
+static Fl_Image* create_thumbnail_placeholder(int width);
+static void thumbnail_loaded_cb(void* data);
 static bool updateVideoMetadataFromVideoList();
 static void getVideosAtList_cb(Fl_Choice* w, void* a);
 static void selectCentralTab_cb(Fl_Choice* w, void* a);
@@ -59,6 +59,7 @@ public:
   static Fl_Menu_Item *history_pause_bttn;
   static Fl_Menu_Item *history_unpause_bttn;
   static Fl_Menu_Item *cache_clearall_bttn;
+  static Fl_Menu_Item *cache_stats_bttn;
   static Fl_Menu_Item *cache_pause_bttn;
   static Fl_Menu_Item *cache_unpause_bttn;
   static Fl_Menu_Item *reset_appconfig_bttn;
@@ -14,17 +14,29 @@
 #ifndef FLCACHE_H
 #define FLCACHE_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <filesystem>
-#include <map>
+#include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <string>
 #include <ctime>
+#include <cstdio>
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
 #include <fstream>
 #include <vector>
 #include "fltube_utils.h"
 
 enum CACHE_RECORD_STATUS {STOPPED, STARTED};
 
+/* Formats of the file where a @PermanentDiskCache is saved. */
+enum CACHE_FILE_FORMAT {TEXT_FORMAT, BINARY_FORMAT};
+
 /* This entity represents a general cache entry. It has a string value, a creation date, a time to live (expressed in seconds),
  *  and a "valid" flag. Once created, the cache entry values cannot be changed.
  *  A cache entry becames invalid automatically when reachs its invalidation date, it means: current_date >= (creation_date + ttl).
@@ -57,12 +69,16 @@ public:
     std::string get();
 
     /* Returns the expiration date for this cache entry.  */
-    time_t get_expiration();
+    time_t get_expiration() const;
 
     time_t get_creation_date () {
         return creation_date;
     }
 
+    size_t get_value_size() const {
+        return value.capacity();
+    }
+
     /* TTL: Time to live of this entry. */
     unsigned int get_ttl() {
         return ttl;
@@ -71,65 +87,462 @@ public:
     //TODO  Add a way to update a cache entry value?
 };
 
-/*  This general cache is a memory cache. Add, update, select or remove cache entries. */
+/* Result of @GeneralCache::lookup(): the value of a valid entry and its expiration, found with a single lookup. */
+struct Cache_Lookup {
+    bool found = false;
+    std::string value;
+    time_t expiration = 0;
+};
+
+/* Counters of a @GeneralCache. */
+struct Cache_Stats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    /* Lookups of a valid entry, and lookups of a missing (or expired) entry. */
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    unsigned long insertions = 0;
+    /* Entries removed to keep the capacity, and entries removed because they expired. */
+    unsigned long evictions = 0;
+    unsigned long expirations = 0;
+    /* Values resolved on a miss (i.e. by yt-dlp), and their average time in milliseconds: the time a hit avoids. */
+    unsigned long resolves = 0;
+    double average_resolve_ms = 0;
+};
+
+/* Returns the counters as a single line for the debug log, i.e. "URL cache: 10 entries (12 KB), 5 hits, ...". When resolve
+ * times were recorded, the time saved by the hits is estimated from their average. */
+std::string format_cache_stats(const std::string& cache_name, const Cache_Stats& stats);
+
+/* Policy of a @GeneralCache: how the expiration, the validity and the size of an entry are obtained.
+ * This default policy never expires entries, and only counts the size of the key and value objects. */
+template <typename K, typename V>
+struct Default_Cache_Policy {
+    /* Expiration date of an entry, or 0 if it never expires. */
+    static time_t expiration(const V& value) {
+        return 0;
+    }
+
+    /* True if the entry can be returned by a lookup. */
+    static bool is_valid(V& value) {
+        time_t expiration_date = expiration(value);
+        return expiration_date == 0 || time(0) < expiration_date;
+    }
+
+    /* Approximate count of bytes used by an entry, to keep the capacity. */
+    static size_t footprint(const K& key, const V& value) {
+        return sizeof(K) + sizeof(V);
+    }
+
+    /* Called, with the shard of the entry locked, when an entry is evicted to keep the capacity (i.e. to release a
+     * resource owned by the value). */
+    static void evicted(const K& key, V& value) {}
+};
+
+/*  This general cache is a memory cache of @V values by @K keys. Add, update, select or remove cache entries.
+ *  Entries are stored inline at hash tables, and linked in least recently used (LRU) order. When the count of entries
+ *  or their total size exceed the configured capacity, the least recently used entries are evicted. Entries that
+ *  expire (as defined by @Policy, see @Default_Cache_Policy) are removed by cleanup().
+ *  The cache is safe to use from several threads: entries are distributed by the hash of their key between shards,
+ *  each one with its own lock, LRU list and capacity, so threads using different entries rarely wait for each other.
+ *  Subclasses can persist the entries, or load them on demand (see @fetch_entry()). */
+template <typename K, typename V, typename Policy = Default_Cache_Policy<K, V>>
 class GeneralCache {
 protected:
-    std::unique_ptr<std::map<std::string, CacheEntry*>> entries;
+    struct Cache_Slot;
+    typedef std::pair<const K, Cache_Slot> slot_node;
+
+    /* A cache entry, and its links at the LRU list. Nodes of an unordered_map are never moved, so the links are stable. */
+    struct Cache_Slot {
+        V entry;
+        /* Footprint of the entry when it was inserted. */
+        size_t bytes = 0;
+        slot_node* newer = nullptr;
+        slot_node* older = nullptr;
+
+        Cache_Slot(V&& e): entry(std::move(e)) {};
+    };
+
+    /* An entry of an expiry queue. It can be stale (the entry was removed, or replaced with a new expiration). */
+    struct Expiry_Item {
+        time_t expiration;
+        K id;
+
+        bool operator>(const Expiry_Item& other) const {
+            return expiration > other.expiration;
+        }
+    };
+
+    /* A part of the cache. Every method, except the constructor, must be called with @mutex locked. */
+    struct Cache_Shard {
+        std::mutex mutex;
+        std::unordered_map<K, Cache_Slot> entries;
+        /* Ends of the LRU list. */
+        slot_node* most_recent = nullptr;
+        slot_node* least_recent = nullptr;
+        /* Approximate count of bytes used by the entries. */
+        size_t total_bytes = 0;
+        /* Capacity of this shard. 0 means no limit. */
+        size_t max_entries = 0;
+        size_t max_bytes = 0;
+        /* Min-heap of the expiration of every entry that expires, so cleanup() only visits the expired ones. */
+        std::priority_queue<Expiry_Item, std::vector<Expiry_Item>, std::greater<Expiry_Item>> expiry_queue;
+        /* Counters of this shard (see @Cache_Stats). */
+        unsigned long hits = 0, misses = 0, insertions = 0, evictions = 0, expirations = 0;
+
+        /* Returns the node for a specified id, and marks it as the most recently used. If not exists, a nullptr is returned. */
+        slot_node* search(const K& id) {
+            auto position = entries.find(id);
+            if (position == entries.end()) return nullptr;
+            slot_node* node = &(*position);
+            if (node != most_recent) {
+                unlink(node);
+                link_as_most_recent(node);
+            }
+            return node;
+        }
+
+        /* Insert a new entry as the most recently used (replacing the entry with the same id, if any). Returns the
+         * count of entries evicted to keep the capacity. */
+        size_t insert(const K& id, V&& entry) {
+            auto existing = entries.find(id);
+            if (existing != entries.end()) erase(&(*existing));
+            size_t bytes = sizeof(slot_node) + Policy::footprint(id, entry);
+            time_t expiration = Policy::expiration(entry);
+            if (expiration != 0) expiry_queue.push({ expiration, id });
+            auto inserted = entries.emplace(id, Cache_Slot(std::move(entry)));
+            inserted.first->second.bytes = bytes;
+            link_as_most_recent(&(*inserted.first));
+            total_bytes += bytes;
+            insertions++;
+            size_t count_evicted = evict();
+            compact_expiry_queue();
+            return count_evicted;
+        }
+
+        void unlink(slot_node* node) {
+            Cache_Slot& slot = node->second;
+            if (slot.newer != nullptr) slot.newer->second.older = slot.older;
+            else most_recent = slot.older;
+            if (slot.older != nullptr) slot.older->second.newer = slot.newer;
+            else least_recent = slot.newer;
+            slot.newer = slot.older = nullptr;
+        }
+
+        void link_as_most_recent(slot_node* node) {
+            node->second.older = most_recent;
+            node->second.newer = nullptr;
+            if (most_recent != nullptr) most_recent->second.newer = node;
+            most_recent = node;
+            if (least_recent == nullptr) least_recent = node;
+        }
+
+        void erase(slot_node* node) {
+            unlink(node);
+            total_bytes -= node->second.bytes;
+            entries.erase(node->first);
+        }
+
+        void clear() {
+            entries.clear();
+            expiry_queue = decltype(expiry_queue)();
+            most_recent = least_recent = nullptr;
+            total_bytes = 0;
+        }
+
+        /* Evict the least recently used entries until the shard fits its capacity. Returns the count of evicted entries. */
+        size_t evict() {
+            size_t count_evicted = 0;
+            while (least_recent != nullptr && ((max_entries > 0 && entries.size() > max_entries) || (max_bytes > 0 && total_bytes > max_bytes))) {
+                // The last entry added is never evicted, even if it's bigger than the whole capacity.
+                if (least_recent == most_recent) break;
+                Policy::evicted(least_recent->first, least_recent->second.entry);
+                erase(least_recent);
+                count_evicted++;
+            }
+            evictions += count_evicted;
+            return count_evicted;
+        }
+
+        /* Remove the entries expired at @now. Returns the count of removed entries. */
+        size_t remove_expired(time_t now) {
+            size_t count_removed = 0;
+            while (!expiry_queue.empty() && expiry_queue.top().expiration <= now) {
+                Expiry_Item item = expiry_queue.top();
+                expiry_queue.pop();
+                auto position = entries.find(item.id);
+                // A stale item: the entry was removed, or replaced by a newer one that expires later.
+                if (position == entries.end()) continue;
+                time_t expiration = Policy::expiration(position->second.entry);
+                if (expiration == 0 || expiration > now) continue;
+                erase(&(*position));
+                count_removed++;
+            }
+            expirations += count_removed;
+            return count_removed;
+        }
+
+        /* Rebuild @expiry_queue from the current entries when most of its items are stale, so its size stays
+         * proportional to the count of entries. */
+        void compact_expiry_queue() {
+            if (expiry_queue.size() <= 2 * entries.size() + 64) return;
+            std::vector<Expiry_Item> items;
+            items.reserve(entries.size());
+            for (const slot_node& node: entries) {
+                time_t expiration = Policy::expiration(node.second.entry);
+                if (expiration != 0) items.push_back({ expiration, node.first });
+            }
+            expiry_queue = decltype(expiry_queue)(std::greater<Expiry_Item>(), std::move(items));
+        }
+    };
+
+    /* Created once, so the shards are never moved. */
+    std::vector<Cache_Shard> shards;
+
+    /* Resolve times recorded by record_resolve_time(). */
+    std::mutex resolve_mutex;
+    unsigned long resolves = 0;
+    double total_resolve_ms = 0;
+
+    Cache_Shard& shard_for(const K& id) {
+        return shards[std::hash<K>{}(id) % shards.size()];
+    }
+
+    /* Lock every shard (in order, so two threads locking all of them never deadlock). */
+    std::vector<std::unique_lock<std::mutex>> lock_all_shards() {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards.size());
+        for (Cache_Shard& shard: shards) locks.emplace_back(shard.mutex);
+        return locks;
+    }
+
+    /* Search an entry at @shard (which must be locked), asking @fetch_entry() for entries not in memory. */
+    slot_node* find(Cache_Shard& shard, const K& id) {
+        slot_node* node = shard.search(id);
+        if (node != nullptr) return node;
+        std::unique_ptr<V> fetched = fetch_entry(id);
+        if (fetched == nullptr) return nullptr;
+        shard.insert(id, std::move(*fetched));
+        return shard.search(id);
+    }
+
+    /* Same as find(), but only returns a valid entry, and counts the lookup as a hit or a miss (unless @counted is false,
+     * for lookups that don't need the value, i.e. to show if an entry is cached). */
+    slot_node* find_valid(Cache_Shard& shard, const K& id, bool counted = true) {
+        slot_node* node = find(shard, id);
+        if (node != nullptr && !Policy::is_valid(node->second.entry)) node = nullptr;
+        if (!counted) return node;
+        if (node != nullptr) shard.hits++;
+        else shard.misses++;
+        return node;
+    }
+
+    /* Hook called, with the shard of the entry locked, when an id is not in memory, so a subclass can provide entries
+     * loaded on demand. Returns nullptr if the entry doesn't exist. */
+    virtual std::unique_ptr<V> fetch_entry(const K& id) {
+        return nullptr;
+    };
+
+public:
+    const static size_t DEFAULT_SHARDS_COUNT = 8;
+
+    /* Create the cache without capacity limits (see @set_capacity()). A cache used by few threads, or whose capacity is
+     * small, can use a single shard. */
+    GeneralCache(size_t shards_count = DEFAULT_SHARDS_COUNT): shards(std::max<size_t>(1, shards_count)) {};
+
+    virtual ~GeneralCache() {};
+
+    /* Change the capacity of the cache (0 means no limit), evicting entries if necessary. The capacity is divided
+     * between the shards. */
+    void set_capacity(size_t max_entries, size_t max_bytes) {
+        // Rounded up, so a small capacity is not lost by the division between shards.
+        size_t shard_max_entries = (max_entries + shards.size() - 1) / shards.size();
+        size_t shard_max_bytes = (max_bytes + shards.size() - 1) / shards.size();
+        for (Cache_Shard& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.max_entries = shard_max_entries;
+            shard.max_bytes = shard_max_bytes;
+            shard.evict();
+        }
+    }
+
+    /* Add an entry, replacing the entry with the same key (if any). Its footprint is computed again, so a value that
+     * grows can be put again to update it. Returns the count of entries evicted to keep the capacity. */
+    size_t put(const K& id, V entry) {
+        Cache_Shard& shard = shard_for(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.insert(id, std::move(entry));
+    }
+
+    /* Copy the value of a valid entry to @entry, and mark it as the most recently used. Returns false if not found. */
+    bool get(const K& id, V& entry) {
+        Cache_Shard& shard = shard_for(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        slot_node* node = find_valid(shard, id);
+        if (node == nullptr) return false;
+        entry = node->second.entry;
+        return true;
+    }
+
+    /* Returns true if the entry exists and was deleted. */
+    bool remove(const K& id) {
+        Cache_Shard& shard = shard_for(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        slot_node* node = find(shard, id);
+        if (node == nullptr) return false;
+        shard.erase(node);
+        return true;
+    }
+
+    void clear() {
+        for (Cache_Shard& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.clear();
+        }
+    }
+
+    /* Remove the entries that reached their expiration date. Only the expired entries are visited, so it can be called
+     * periodically. Returns the count of removed entries. */
+    size_t cleanup() {
+        time_t now = time(0);
+        size_t count_removed = 0;
+        for (Cache_Shard& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count_removed += shard.remove_expired(now);
+        }
+        return count_removed;
+    }
+
+    /* Record the milliseconds needed to obtain a value that was not cached, to estimate the time saved by the hits. */
+    void record_resolve_time(double milliseconds) {
+        std::lock_guard<std::mutex> lock(resolve_mutex);
+        resolves++;
+        total_resolve_ms += milliseconds;
+    }
+
+    Cache_Stats get_stats() {
+        Cache_Stats stats;
+        {
+            std::lock_guard<std::mutex> lock(resolve_mutex);
+            stats.resolves = resolves;
+            if (resolves > 0) stats.average_resolve_ms = total_resolve_ms / resolves;
+        }
+        for (Cache_Shard& shard: shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            stats.entries += shard.entries.size();
+            stats.bytes += shard.total_bytes;
+            stats.hits += shard.hits;
+            stats.misses += shard.misses;
+            stats.insertions += shard.insertions;
+            stats.evictions += shard.evictions;
+            stats.expirations += shard.expirations;
+        }
+        return stats;
+    }
+};
+
+/* Policy of the URL cache entries: they expire at the end of their TTL, or when marked as invalid. */
+struct URL_Cache_Policy {
+    static time_t expiration(const CacheEntry& entry) {
+        return entry.get_expiration();
+    }
+
+    static bool is_valid(CacheEntry& entry) {
+        return entry.is_valid();
+    }
+
+    static size_t footprint(const std::string& id, const CacheEntry& entry) {
+        return id.capacity() + entry.get_value_size();
+    }
+
+    static void evicted(const std::string& id, CacheEntry& entry) {}
+};
+
+/*  The cache of the final URLs of the videos, by video id. A cache entry has a TTL (see @CacheEntry), and the recording of
+ *  new entries can be paused (see @change_status()). */
+class URLCache: public GeneralCache<std::string, CacheEntry, URL_Cache_Policy> {
+protected:
     std::shared_ptr<TerminalLogger> logger;
 
     unsigned int cache_entry_ttl;
 
-    CACHE_RECORD_STATUS current_status;
+    std::atomic<CACHE_RECORD_STATUS> current_status;
+
+    /* Insert an entry (i.e. loaded from a datasource), replacing the entry with the same id, if any. */
+    void insert(const std::string& id, CacheEntry&& entry);
+
+    /* Hooks called, with the shard of the entry locked, when add_entry(), remove_entry() or remove_all_entries() change
+     * the cache, so a subclass can record the change. Evictions and expirations are not notified. */
+    virtual void entry_added(const std::string& id, CacheEntry& entry) {};
+    virtual void entry_removed(const std::string& id) {};
+    virtual void all_entries_removed() {};
 
-    /* Returns the @CacheEntry for a specified id. If not exists, a nullptr is returned. */
-    CacheEntry* search(std::string id);
     /* Hook method used for Class Constructor to load data from the corresponding datasource. */
     virtual int load();
 
     /* This function must be implemented for every subclass to "save" the data in any form required. */
     virtual int save();
+
+    /* Implementation of lookup() and peek(). */
+    Cache_Lookup find_lookup(const std::string& id, bool counted);
 public:
-    GeneralCache(std::shared_ptr<TerminalLogger> const& lgg, unsigned int ttl = CacheEntry::DEFAULT_ENTRY_TTL):
-    logger(lgg), entries(std::make_unique<std::map<std::string, CacheEntry*>>()), current_status(CACHE_RECORD_STATUS::STARTED),
-    cache_entry_ttl(ttl) {};
+    /* Default capacity: count of entries, and size in bytes (a stream URL is 1-2 KB). */
+    const static size_t DEFAULT_MAX_ENTRIES = 1000;
+    const static size_t DEFAULT_MAX_BYTES = 2 * 1024 * 1024;
 
-    /* Destructor. */
-    ~GeneralCache();
+    URLCache(std::shared_ptr<TerminalLogger> const& lgg, unsigned int ttl = CacheEntry::DEFAULT_ENTRY_TTL):
+    logger(lgg), cache_entry_ttl(ttl), current_status(CACHE_RECORD_STATUS::STARTED) {
+        set_capacity(DEFAULT_MAX_ENTRIES, DEFAULT_MAX_BYTES);
+    };
 
     void init();
 
     void finish();
 
     /*  ADD a new cache entry, or UPDATES an existing one if its value is different to previous saved. If the entry exists
-     *  in the chache, and it is marked as invalid, replace this cache entry with a new valid entry. */
-    void add_entry(std::string id, const std::string value);
+     *  in the chache, and it is marked as invalid, replace this cache entry with a new valid entry.
+     *  If @expiration is not 0, the entry expires at that date when it comes before the end of the cache TTL. */
+    void add_entry(std::string id, const std::string value, time_t expiration = 0);
+
+    /*  Returns the value and expiration of a valid entry, with a single lookup. */
+    Cache_Lookup lookup(const std::string& id);
+
+    /*  Same as lookup(), but not counted as a hit or a miss at the cache stats: for the lookups that only show or check
+     *  if an URL is cached, so the stats only count the URLs needed to stream. */
+    Cache_Lookup peek(const std::string& id);
 
     /*  Returns an existing cache entry's value, or an empty string (@CacheEntry::EMPTY_VALUE) if it doesn't exist (or it is marked as or became invalid). */
     std::string get_entry_value(std::string id);
 
-    /* Returns true if the entry exists and was deleted succesfully. Besides, the pointer to CacheEntry* is deleted.  */
+    /* Returns true if the entry exists and was deleted succesfully.  */
     bool remove_entry(std::string id);
 
     void remove_all_entries();
 
-    /* Returns true if an "id" exists within cache entries and is valid. Otherwise, return false.  */
+    /* Returns true if an "id" exists within cache entries and is valid. Otherwise, return false. Not counted at the stats. */
     bool is_cached(std::string id);
 
     /* Returns a formatted string representing the hour of expiration of an specified entry. */
     std::string get_cache_expiration_date(std::string id);
 
-    /* Iterate over every cache entry and mark as invalid those who reached its invalidation date. */
-    void cleanup();
+    /* Format an expiration time as returned by lookup(), the same way than get_cache_expiration_date(). */
+    static std::string format_expiration(time_t expiration);
+
+    /* Same as GeneralCache::cleanup(), logging the count of removed entries. */
+    size_t cleanup();
 
     /* Update the current cache recording status. Returns @true if switching to the new status is allowed;
      * switching to the same status returns @false. */
     bool change_status(CACHE_RECORD_STATUS next_status);
 };
 
-/*  This is like a GeneralCache but save it at your disk for a permanent storage of its data. A cache entry mark as invalid, is not
+/*  This is like a URLCache but save it at your disk for a permanent storage of its data. A cache entry mark as invalid, is not
  *  saved at disk.
+ *  Data is kept at two files: a snapshot of the whole cache (the cache file), and a journal where every change made
+ *  since the snapshot is appended, so changes are never lost if FLTube ends without calling finish(). The journal
+ *  is compacted (a new snapshot is written, and the journal truncated) periodically by @compact_journal().
  */
-class PermanentDiskCache: public GeneralCache {
+class PermanentDiskCache: public URLCache {
 private:
     const std::string DEFAULT_SAVE_PATH = std::filesystem::temp_directory_path();
     const std::string DEFAULT_SAVE_FILENAME = "cache.txt";
@@ -137,32 +550,146 @@ private:
     std::string dirname;
     /*  This is the filesystem filename for the cache file. */
     std::string filename;
+    /* The journal opened for append, and the count of records written since the last compaction. */
+    std::mutex journal_mutex;
+    FILE* journal = nullptr;
+    size_t journal_records = 0;
+    /* Only one compaction runs at the same time. */
+    std::mutex compaction_mutex;
+
+    /* Layout of the binary snapshot: this header, an index of entries sorted by id, and a heap with the ids and values.
+     * Offsets of the index items are relative to the heap. Numbers use the byte order of the host (the file is never shared). */
+    struct Binary_Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t entries_count;
+        uint64_t index_offset;
+        uint64_t heap_offset;
+        uint64_t heap_size;
+    };
+    struct Binary_Index_Item {
+        uint64_t id_offset;
+        uint64_t value_offset;
+        uint32_t id_size;
+        uint32_t value_size;
+        int64_t creation_date;
+        uint32_t ttl;
+        uint32_t reserved;
+    };
+    /* A valid entry copied to be written at a snapshot. */
+    struct Saved_Entry {
+        std::string id;
+        std::string value;
+        time_t creation_date;
+        unsigned int ttl;
+    };
+
+    CACHE_FILE_FORMAT file_format = TEXT_FORMAT;
+    /* The binary snapshot mapped at memory. Its entries are fetched on the first lookup of their id, and from then
+     * on the id is at @shadowed_ids, as every id added, replaced or removed since the snapshot was mapped. */
+    std::mutex mapping_mutex;
+    const char* mapped_data = nullptr;
+    size_t mapped_size = 0;
+    std::unordered_set<std::string> shadowed_ids;
+
     /* Returns true if directory set to this cache exists and is a directory. Must be used every time cache is saved to disk. */
     bool validate_save_directory();
     /* Returns true if cache filename exists or could be created. Must be used every time cache is saved to disk. */
     bool validate_save_filename();
+
+    std::string snapshot_path() {
+        return dirname + "/" + filename;
+    }
+    std::string journal_path() {
+        return snapshot_path() + ".journal";
+    }
+    /* The binary snapshot is saved next to the text one, with the ".bin" extension. */
+    std::string binary_snapshot_path() {
+        return std::filesystem::path(snapshot_path()).replace_extension(".bin");
+    }
+    std::string saved_snapshot_path() {
+        return (file_format == BINARY_FORMAT) ? binary_snapshot_path() : snapshot_path();
+    }
+
+    /* Open the journal for append. Must be called with @journal_mutex locked. */
+    bool open_journal();
+    /* Append a record to the journal (if opened). */
+    void append_to_journal(const std::string& record);
+    /* Parse an entry saved as ID>VALUE>CREATION_DATE>TTL. Returns false if the line is malformed. */
+    bool parse_entry(const std::string& line, std::string& id, std::string& value, unsigned long int& creation_date, int& ttl);
+    /* Read the snapshot (@is_journal false) or a journal at @path, applying every line to the cache. Returns the count
+     * of lines read, or -1 if the file cannot be opened. */
+    int read_cache_file(const std::string& path, bool is_journal, int& count_rejected, int& count_not_valid);
+    /* Write every valid cache entry (in memory or still mapped) to a temporary file, and rename it as the snapshot of the
+     * configured format. The snapshot of the other format is removed. */
+    bool write_snapshot();
+    /* Copy every valid entry, in LRU order. */
+    std::vector<Saved_Entry> collect_entries();
+    bool write_text_entries(FILE* output, const std::vector<Saved_Entry>& saved_entries);
+    bool write_binary_entries(FILE* output, const std::vector<Saved_Entry>& saved_entries);
+
+    /* Map the binary snapshot at @path, checking its header. Returns the count of entries, or -1 on error. */
+    long map_binary_snapshot(const std::string& path);
+    /* Must be called with @mapping_mutex locked. */
+    void unmap_binary_snapshot();
+    /* Returns the id and value of an index item (empty if its offsets are out of the heap). */
+    std::string_view mapped_id(const Binary_Index_Item& item);
+    std::string_view mapped_value(const Binary_Index_Item& item);
+    /* Binary search of @id at the mapped index. Must be called with @mapping_mutex locked. */
+    const Binary_Index_Item* find_mapped(const std::string& id);
+    /* Never fetch @id from the mapped snapshot. */
+    void shadow(const std::string& id);
+
+protected:
+    void entry_added(const std::string& id, CacheEntry& entry) override;
+    void entry_removed(const std::string& id) override;
+    void all_entries_removed() override;
+    std::unique_ptr<CacheEntry> fetch_entry(const std::string& id) override;
+
 public:
     static const char FIELD_SEPARATOR = '>';
     /* Total number of fields persisted in each line of the cache file.  */
     static const short int TOTAL_FIELDS_SAVED = 4;
+    /* First character of every journal record: an added (or replaced) entry, a removed entry, or all entries removed. */
+    static const char JOURNAL_ADD = '+';
+    static const char JOURNAL_REMOVE = '-';
+    static const char JOURNAL_CLEAR = '*';
+    /* Count of journal records that makes @compact_journal() write a new snapshot. */
+    static const size_t JOURNAL_COMPACTION_RECORDS = 500;
+    static constexpr char BINARY_MAGIC[8] = { 'F', 'L', 'T', 'C', 'A', 'C', 'H', 'E' };
+    static const uint32_t BINARY_VERSION = 1;
 
     enum FIELDS_POS { ID, FINAL_URL, CREATION_DATE, TTL };
 
     PermanentDiskCache(std::shared_ptr<TerminalLogger> const& lgg, unsigned int ttl = CacheEntry::DEFAULT_ENTRY_TTL):
-            GeneralCache(lgg,ttl) {};
+            URLCache(lgg,ttl) {};
+
+    ~PermanentDiskCache();
 
     /*  Set the path to an existing directory to save the cache file. */
     void set_save_directory_path(std::string dirname_path, std::string filename);
 
+    /* Set the format of the cache file (text by default). Must be set before init(). A cache file saved with the other
+     * format is loaded and converted. */
+    void set_file_format(CACHE_FILE_FORMAT format) {
+        file_format = format;
+    }
+
+    /* Write a new snapshot and start an empty journal, if the journal has at least @JOURNAL_COMPACTION_RECORDS records
+     * (or always, if @force is true). It can be called from any thread. Returns 0 on success, or if not required. */
+    int compact_journal(bool force = false);
+
 protected:
-    /* Load every entry saved at cache file, and only populate the cache with those entries that are valid. */
+    /* Load the snapshot and then replay the journal, and only populate the cache with those entries that are valid.
+     * A binary snapshot is only mapped: its entries are fetched when looked up. */
     int load() override;
 
-    /* Save every valid cache entry to the cache file. The format of every saved line is the following:
+    /* Save every valid cache entry to the cache file (compacting the journal). The format of every saved line is the following:
      *  ID>VALUE>CREATION_DATE>TTL
+     *  Journal records are the same line preceded by @JOURNAL_ADD, an ID preceded by @JOURNAL_REMOVE, or a single @JOURNAL_CLEAR.
+     *  The binary format is described at @Binary_Header.
      */
     int save() override;
 };
 
-
 #endif      // FLCACHE_H
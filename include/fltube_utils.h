@@ -34,6 +34,10 @@
 #include <algorithm>
 #include <cstring>
 #include <regex>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <signal.h>
 
 #include <FL/Fl_Image.H>
 #include <FL/Fl_JPEG_Image.H>
@@ -190,9 +194,38 @@ public:
     std::string getExtraParams() {   return this->extra_live_parameters; }
 };
 
-std::string exec(const char* cmd, int& exitStatus);
+/**
+ * Allows to cancel, from another thread, the work done on behalf of an user action (i.e. a search).
+ * Running child processes can be attached to the token, so they receive a signal as soon as the token is cancelled.
+ * A token can be shared by several tasks running at the same time: each one attaches (and detaches) its own process.
+ */
+class Cancellation_Token {
+private:
+    std::mutex token_mutex;
+    std::atomic<bool> cancelled;
+    /* Signal to send to every attached process, by process id. */
+    std::map<pid_t, int> attached_pids;
+public:
+    Cancellation_Token(): cancelled(false) {};
 
-std::string exec(const char* cmd);
+    /* Mark the token as cancelled, and send the configured signal to every attached process. */
+    void cancel();
+
+    bool is_cancelled() {
+        return cancelled.load();
+    }
+
+    /* Attach a process (or a process group, if @pid is negative) that must receive @signal_number on cancel.
+     * Returns false, and nothing is attached, if the token is already cancelled. */
+    bool attach(pid_t pid, int signal_number);
+
+    /* Detach a process attached with attach(). Other processes attached to the token stay attached. */
+    void detach(pid_t pid);
+};
+
+std::string shell_quote(const std::string& arg);
+
+std::string join_shell_args(const std::vector<std::string>& args);
 
 bool isUrl(const char* user_input);
 
@@ -206,8 +239,16 @@ bool checkDirectoryPermissions(const char* directory, std::array<SIMPLE_FS_PERMI
 
 bool canWriteOnDir(const char* directory);
 
+bool write_file_atomically(const std::string& path, const std::function<bool(FILE*)>& write_content);
+
+bool write_file_atomically(const std::string& path, const std::string& content);
+
+void init_curl();
+
 static CURL* get_curl_handle(const char* forURL, FILE* output_file = nullptr);
 
+CURL* get_curl_handle(const char* forURL, std::string& output_buffer);
+
 FLTUBE_STATUS_CODES download_file(std::string url, std::string output_dir, std::string outfilename, bool overwrite = false);
 
 FLTUBE_STATUS_CODES check_url_access(std::string url);
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef JSON_PARSER_H
+#define JSON_PARSER_H
+
+#include <string>
+#include <string_view>
+
+/**
+ * Receives the events generated by @JsonSaxParser. Every std::string_view passed to a handler is only valid during
+ * the call: it points to the parsed text, or to an internal buffer of the parser if the JSON string had escape sequences.
+ */
+class JsonSaxHandler {
+public:
+    virtual ~JsonSaxHandler() {};
+    virtual void on_start_object() {};
+    virtual void on_end_object() {};
+    virtual void on_start_array() {};
+    virtual void on_end_array() {};
+    /* Name of the next value inside an object. */
+    virtual void on_key(std::string_view key) {};
+    virtual void on_string(std::string_view value) {};
+    /* Numbers are passed as they are written at the JSON text, so the handler decides how (and if) convert them. */
+    virtual void on_number(std::string_view raw_number) {};
+    virtual void on_bool(bool value) {};
+    virtual void on_null() {};
+};
+
+/**
+ * A small event based (SAX) JSON parser. It never builds a DOM nor copies the parsed text: keys and strings are passed
+ * to the handler as views of the input, unless they contain escape sequences (then they are decoded at a buffer that is
+ * reused for every string).
+ */
+class JsonSaxParser {
+private:
+    std::string_view text;
+    size_t pos;
+    unsigned int depth;
+    std::string unescaped_buffer;
+    JsonSaxHandler* handler;
+
+    void skip_whitespaces();
+    bool parse_value();
+    bool parse_object();
+    bool parse_array();
+    /* Parse a JSON string at current position. @value points to the string content, already decoded. */
+    bool parse_string(std::string_view& value);
+    bool parse_number();
+    bool parse_literal(std::string_view literal);
+    /* Decode the escape sequences of a JSON string content into @unescaped_buffer. */
+    bool unescape(std::string_view raw);
+
+public:
+    /* Nested objects or arrays deeper than this limit are rejected. */
+    static const unsigned int MAX_DEPTH = 64;
+
+    JsonSaxParser(): pos(0), depth(0), handler(nullptr) {};
+
+    /* Parse a complete JSON document, emitting its events to @handler. Returns false if the document is malformed
+     * (events emitted before the error are not reverted). */
+    bool parse(std::string_view json_text, JsonSaxHandler& handler);
+
+    /* Position of the last character processed, useful to report errors. */
+    size_t position() {
+        return pos;
+    }
+};
+
+/* Returns @value as a JSON string (quoted, with the required escape sequences), so it can be parsed by @JsonSaxParser. */
+std::string json_string(std::string_view value);
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef PROCESS_MANAGER_H
+#define PROCESS_MANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <sys/types.h>
+#include "fltube_utils.h"
+
+/* Callback used to receive, line by line, the output printed by a process (without the trailing newline). */
+typedef std::function<void(const std::string&)> process_line_handler;
+
+/* Options for the processes launched by @ProcessManager. */
+struct Process_Options {
+    /* Maximum time (in milliseconds) a process can run before being terminated. Use 0 to wait without limit. */
+    unsigned int timeout_ms = 0;
+    /* If not empty, the stderr of the process is appended to this file. Otherwise, it is inherited from FLTube. */
+    std::string stderr_path;
+    /* If true, the stdout of the process is passed to the line handler. Otherwise, it is inherited from FLTube. */
+    bool capture_output = true;
+    /* If not nullptr, cancelling this token terminates the process. */
+    Cancellation_Token* token = nullptr;
+};
+
+/* Exit status and resources used by a process launched by @ProcessManager. */
+struct Process_Result {
+    // False if the process cannot be created (i.e. the binary doesn't exist). See @spawn_error.
+    bool spawned = false;
+    int spawn_error = 0;
+    // Exit status of the process, or -1 if it didn't exit normally (i.e. was killed by a signal).
+    int exit_status = -1;
+    int term_signal = 0;
+    bool timed_out = false;
+    bool cancelled = false;
+    double wall_seconds = 0;
+    double user_cpu_seconds = 0;
+    double system_cpu_seconds = 0;
+    long max_rss_kb = 0;
+
+    bool succeeded() const {
+        return spawned && exit_status == 0;
+    }
+};
+
+/**
+ * Launch external programs (yt-dlp, ffmpeg, the media player) with posix_spawn and an argv array, so no shell is
+ * involved and arguments never need quoting. Every launch runs at its own process group, so a timeout or a cancellation
+ * terminates the program and all of its children. The CPU and wall time of every process are written to the debug log.
+ */
+class ProcessManager {
+private:
+    std::shared_ptr<TerminalLogger> logger;
+
+    /* Spawn @argv at the process group @pgid (0 creates a new group). If @stdin_fd or @stdout_fd are >= 0, they are used
+     * as stdin/stdout of the process, else /dev/null and the FLTube stdout are used. Returns -1 if spawn fails. */
+    pid_t spawn(const std::vector<std::string>& argv, pid_t pgid, int stdin_fd, int stdout_fd, const Process_Options& options, int& spawn_error);
+
+    /* Wait for @pids (all of them at the @pgid process group), passing every line read from @output_fd (if >= 0) to
+     * @on_line, and terminating the group on timeout or cancellation. Returns the result of every process. */
+    std::vector<Process_Result> supervise(const std::vector<std::vector<std::string>>& commands, const std::vector<pid_t>& pids,
+                                          pid_t pgid, int output_fd, const process_line_handler& on_line, const Process_Options& options);
+
+    void log_result(const std::vector<std::string>& argv, pid_t pid, const Process_Result& result);
+
+public:
+    /* Milliseconds given to a process to exit after a SIGTERM, before killing it with SIGKILL. */
+    constexpr static unsigned int TERMINATE_GRACE_MS = 2000;
+
+    ProcessManager(std::shared_ptr<TerminalLogger> const& lgg): logger(lgg) {};
+
+    /* Run @argv (argv[0] is searched at $PATH) and wait for it. */
+    Process_Result run(const std::vector<std::string>& argv, const process_line_handler& on_line, const Process_Options& options = {});
+
+    /* Same as above, but returns the whole output of the process. */
+    std::string run(const std::vector<std::string>& argv, Process_Result& result, const Process_Options& options = {});
+
+    /* Run "@producer | @consumer" and wait for both. Returns the result of @consumer (the result of @producer is only logged). */
+    Process_Result run_pipeline(const std::vector<std::string>& producer, const std::vector<std::string>& consumer, const Process_Options& options = {});
+
+    /* Split a command line from the configuration (i.e. the media player parameters) into arguments.
+     * Whitespaces separate arguments, unless quoted with single or double quotes. */
+    static std::vector<std::string> split_args(const std::string& command_line);
+};
+
+#endif
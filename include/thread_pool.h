@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <array>
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "fltube_utils.h"
+
+/* Lanes of @ThreadPool, ordered by priority (the first one has the highest priority). */
+enum TASK_LANE {
+    // Work the user is waiting for: streams and searches.
+    LANE_INTERACTIVE,
+    // Work that could be useful soon (i.e. prefetch of the next page). It can be dropped if the pool is busy.
+    LANE_SPECULATIVE,
+    // Maintenance work (i.e. cache flushes).
+    LANE_HOUSEKEEPING
+};
+
+const int TASK_LANES_COUNT = 3;
+
+typedef std::function<void()> pool_task;
+
+/* Counters of a @ThreadPool lane. Latencies are measured in milliseconds. */
+struct Lane_Stats {
+    // Tasks waiting for a worker.
+    size_t queued = 0;
+    size_t running = 0;
+    unsigned long submitted = 0;
+    unsigned long completed = 0;
+    // Tasks not accepted because the lane queue was full.
+    unsigned long rejected = 0;
+    // Time between the submit and the start of a task.
+    double average_wait_ms = 0;
+    double max_wait_ms = 0;
+    // Time spent running a task.
+    double average_run_ms = 0;
+};
+
+/**
+ * A fixed set of worker threads, shared by the whole application, that run tasks from three priority lanes.
+ * A free worker always takes the oldest task of the highest priority lane. Speculative and housekeeping tasks
+ * never use more than @background_limit workers at the same time, so some workers are always left for interactive
+ * tasks (which are mostly waiting for yt-dlp or the media player, not using the CPU).
+ * Interactive tasks are never rejected; the other lanes have a bounded queue.
+ */
+class ThreadPool {
+private:
+    struct Queued_Task {
+        pool_task task;
+        std::chrono::steady_clock::time_point submit_time;
+    };
+
+    /* Counters kept by lane. */
+    struct Lane_State {
+        std::deque<Queued_Task> queue;
+        size_t running = 0;
+        unsigned long submitted = 0;
+        unsigned long completed = 0;
+        unsigned long rejected = 0;
+        double total_wait_ms = 0;
+        double max_wait_ms = 0;
+        double total_run_ms = 0;
+    };
+
+    /* State shared with the workers, so a worker running a long task (i.e. the media player) at application exit
+     * can end after the pool is destroyed. */
+    struct Shared_State {
+        std::mutex mutex;
+        std::condition_variable task_available;
+        std::array<Lane_State, TASK_LANES_COUNT> lanes;
+        size_t background_running = 0;
+        size_t background_limit = 1;
+        bool stopping = false;
+    };
+
+    std::shared_ptr<Shared_State> state;
+    std::shared_ptr<TerminalLogger> logger;
+    unsigned int workers_count;
+
+    static void worker_loop(std::shared_ptr<Shared_State> state);
+    /* Pop the next task that can run now. Must be called with the state mutex locked. */
+    static bool next_task(Shared_State& state, Queued_Task& task, int& lane);
+
+public:
+    /* Maximum count of queued tasks by lane. 0 means unbounded. */
+    constexpr static std::array<size_t, TASK_LANES_COUNT> MAX_QUEUED_TASKS = { 0, 32, 16 };
+
+    /* Create the pool with @workers workers (at least 2). If @workers is 0, @default_size() is used. */
+    ThreadPool(std::shared_ptr<TerminalLogger> const& lgg, unsigned int workers = 0);
+
+    /* Queued tasks are discarded. Running tasks are not waited for. */
+    ~ThreadPool();
+
+    /* Queue @task at @lane. Returns false if the lane queue is full or the pool is stopping. */
+    bool submit(TASK_LANE lane, pool_task task);
+
+    Lane_Stats get_stats(TASK_LANE lane);
+
+    unsigned int size() {
+        return workers_count;
+    }
+
+    /* Write the counters of every lane to the debug log. */
+    void log_stats();
+
+    /* The CPU count plus 2 (interactive tasks are mostly waiting for processes), and at least 4. */
+    static unsigned int default_size();
+};
+
+#endif
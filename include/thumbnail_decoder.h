@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef THUMBNAIL_DECODER_H
+#define THUMBNAIL_DECODER_H
+
+#include <string>
+#include <FL/Fl_Image.H>
+
+/**
+ * Resize an image (@depth bytes by pixel, @source_ld bytes by row) to a smaller one, averaging the area of the source
+ * pixels covered by every target pixel. The rows are reduced first, with SSE2 or NEON instructions when available, and
+ * then the columns of the (already reduced) rows. @target must have room for @target_w * @target_h * @depth bytes.
+ */
+void resize_area_average(const unsigned char* source, int source_w, int source_h, int source_ld, int depth,
+                         unsigned char* target, int target_w, int target_h);
+
+/**
+ * Returns the JPEG image at @jpg_filepath resized to @target_width (keeping its aspect ratio), or nullptr if it cannot
+ * be decoded. If FLTube is built with FAST_JPEG_DECODE=1, libjpeg decodes it directly at the smallest scale (1/8 steps)
+ * not narrower than @target_width; otherwise, it is decoded at full size by FLTK.
+ */
+Fl_RGB_Image* decode_resized_jpeg(const std::string& jpg_filepath, int target_width);
+
+/* Same as the above, for the JPEG image of @size bytes at @data (i.e. a download not saved yet). */
+Fl_RGB_Image* decode_resized_jpeg(const unsigned char* data, size_t size, int target_width);
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef THUMBNAIL_LOADER_H
+#define THUMBNAIL_LOADER_H
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <curl/curl.h>
+#include "fltube_utils.h"
+
+/* A thumbnail to download: its URL, the file where it is saved (by the @thumbnail_done_handler), and the position (i.e.
+ * the VideoInfo) it belongs to.
+ * If the validators of a saved copy are set, the download is conditional: the server only sends the thumbnail if it changed. */
+struct Thumbnail_Request {
+    size_t slot = 0;
+    std::string url;
+    std::string output_path;
+    std::string etag;
+    std::string last_modified;
+
+    bool is_conditional() const {
+        return !etag.empty() || !last_modified.empty();
+    }
+};
+
+/* Result of a thumbnail download, passed to the @thumbnail_done_handler of its load(). */
+struct Thumbnail_Result {
+    Thumbnail_Request request;
+    /* The value returned by the load() that requested it. */
+    unsigned long generation = 0;
+    /* True if the thumbnail was downloaded (at @data), or is not modified since the saved copy. */
+    bool downloaded = false;
+    /* True if the server answered a conditional download with "304 Not Modified". */
+    bool not_modified = false;
+    size_t bytes = 0;
+    /* The JPEG data downloaded. Empty if not modified. */
+    std::shared_ptr<std::string> data;
+    /* Validators sent by the server, for the next conditional download. */
+    std::string etag;
+    std::string last_modified;
+    double elapsed_ms = 0;
+};
+
+/* Called at the loader thread when a thumbnail download ends (unless the download was cancelled by a newer load()). */
+typedef std::function<void(const Thumbnail_Result&)> thumbnail_done_handler;
+
+/**
+ * Download thumbnails concurrently with the libcurl multi interface, at a single thread that owns the multi handle
+ * (so connections to the thumbnails server are kept open and reused between pages). Every load() replaces the
+ * downloads of the previous one: the page they were requested for is not shown anymore.
+ * Thumbnails are downloaded to memory, so they can be decoded at once; saving them is left to the handler.
+ */
+class ThumbnailLoader {
+private:
+    struct Transfer {
+        Thumbnail_Result result;
+        curl_slist* headers = nullptr;
+        std::chrono::steady_clock::time_point start_time;
+    };
+
+    std::shared_ptr<TerminalLogger> logger;
+    unsigned int max_connections;
+
+    /* State shared with the loader thread, protected by @mutex. */
+    std::mutex mutex;
+    std::condition_variable requests_available;
+    std::vector<Thumbnail_Request> pending;
+    thumbnail_done_handler pending_handler;
+    unsigned long generation = 0;
+    bool stopping = false;
+    /* The multi handle of the loader thread, so load() can wake it up while it waits at curl_multi_poll(). */
+    CURLM* multi = nullptr;
+
+    std::thread loader;
+
+    void loader_loop();
+
+    /* Create the easy handle of @transfer, that downloads to its result data. Returns nullptr if it cannot be created. */
+    CURL* create_transfer(Transfer& transfer);
+
+    /* Release the resources of @transfer, and set its result. */
+    static void finish_transfer(Transfer& transfer, bool succeeded);
+
+    /* CURLOPT_HEADERFUNCTION of a transfer: keeps the ETag and Last-Modified headers at the @Thumbnail_Result. */
+    static size_t read_header(char* buffer, size_t size, size_t count, void* result);
+
+public:
+    /* Maximum count of thumbnails downloaded at the same time from the same server. */
+    const static unsigned int DEFAULT_MAX_CONNECTIONS = 4;
+    /* Seconds to connect to the server, and to download a whole thumbnail. */
+    const static long CONNECT_TIMEOUT = 10;
+    const static long DOWNLOAD_TIMEOUT = 30;
+
+    ThumbnailLoader(std::shared_ptr<TerminalLogger> const& lgg, unsigned int connections = DEFAULT_MAX_CONNECTIONS);
+
+    /* Downloads still running are cancelled. */
+    ~ThumbnailLoader();
+
+    /* Download @requests, cancelling the downloads of the previous load(). @on_done is called at the loader thread for
+     * every download that ends. Returns the generation of this load, passed to @on_done at the @Thumbnail_Result. */
+    unsigned long load(std::vector<Thumbnail_Request> requests, thumbnail_done_handler on_done);
+};
+
+#endif
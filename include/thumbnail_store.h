@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef THUMBNAIL_STORE_H
+#define THUMBNAIL_STORE_H
+
+#include <string>
+#include <memory>
+#include "cache.h"
+#include "fltube_utils.h"
+
+/* A thumbnail saved at a @ThumbnailStore, and the validators sent by the server for it (for conditional downloads). */
+struct Thumbnail_File {
+    std::string path;
+    size_t bytes = 0;
+    std::string etag;
+    std::string last_modified;
+    /* Date of the last download (or revalidation) of the thumbnail. */
+    time_t validated = 0;
+};
+
+/* Policy of the thumbnail store: thumbnails never expire, their size is the size of their file, and the file of an
+ * evicted thumbnail is removed. */
+struct Thumbnail_Store_Policy: Default_Cache_Policy<std::string, Thumbnail_File> {
+    static size_t footprint(const std::string& url, const Thumbnail_File& file) {
+        return url.capacity() + file.bytes;
+    }
+
+    static void evicted(const std::string& url, Thumbnail_File& file);
+};
+
+/**
+ * The thumbnails downloaded, by thumbnail URL, saved at a directory that is kept between sessions (by default,
+ * "~/.cache/fltube/thumbnails"). The total size of the files is limited: the least recently shown thumbnails are
+ * removed first. The order of use and the validators of every thumbnail are saved at an index file by save().
+ * A thumbnail saved more than @REVALIDATE_AFTER seconds ago should be downloaded again with its validators (see
+ * @Thumbnail_Request), so the server only sends it if it changed.
+ */
+class ThumbnailStore: public GeneralCache<std::string, Thumbnail_File, Thumbnail_Store_Policy> {
+private:
+    std::shared_ptr<TerminalLogger> logger;
+    std::string directory;
+    std::string index_path;
+
+    /* Read the index file. Thumbnails whose file is missing are skipped. Returns the count of thumbnails loaded. */
+    int load_index();
+
+    /* Remove the thumbnail files (and partial downloads) at the directory that are not in the store. */
+    void remove_orphan_files();
+
+public:
+    const static size_t DEFAULT_MAX_SIZE_MB = 50;
+    /* A day: thumbnails of a video rarely change. */
+    const static time_t REVALIDATE_AFTER = 24 * 3600;
+    const static std::string INDEX_FILENAME;
+    /* First line of the index file. */
+    const static std::string INDEX_HEADER;
+
+    ThumbnailStore(std::shared_ptr<TerminalLogger> const& lgg);
+
+    /* Use @dirname_path (created if not exists) to save the thumbnails, limiting their total size to @max_bytes (0 means
+     * no limit), and load the thumbnails saved by a previous session. Returns false if the directory cannot be used. */
+    bool open(const std::string& dirname_path, size_t max_bytes);
+
+    /* Write the index file. Returns FLT_OK, or FLT_GENERAL_FAILED if it cannot be written. */
+    int save();
+
+    /* Path of the file @filename at the store directory. */
+    std::string path_for(const std::string& filename) const {
+        return directory + filename;
+    }
+
+    /* Copy the thumbnail saved for @url to @file, and mark it as the most recently used. Returns false if not saved. */
+    bool lookup(const std::string& url, Thumbnail_File& file);
+
+    /* True if @file was downloaded (or revalidated) too long ago. */
+    bool needs_revalidation(const Thumbnail_File& file) const {
+        return time(0) - file.validated > REVALIDATE_AFTER;
+    }
+
+    /* Record a thumbnail downloaded for @url, already at @file.path. */
+    void store(const std::string& url, Thumbnail_File file);
+
+    /* Write @data (the thumbnail downloaded for @url) at @file.path, and record it. Returns false if it cannot be written. */
+    bool save_thumbnail(const std::string& url, Thumbnail_File file, const std::string& data);
+
+    /* Record that the server confirmed the thumbnail saved for @url is not modified. */
+    void revalidated(const std::string& url);
+};
+
+#endif
@@ -93,12 +93,12 @@ class VideoList {
             ytdlp_v->title = v->title;
             ytdlp_v->creators = v->creator;
             ytdlp_v->channel_id = v->channel_id;
-            ytdlp_v->viewers_count = v->views;
-            ytdlp_v->duration = v->duration;
+            ytdlp_v->viewers_count = YtDlp_Helper::parse_metadata_number(v->views);
+            ytdlp_v->duration = YtDlp_Helper::parse_duration(v->duration);
             ytdlp_v->thumbnail_url = v->thumbnail_url;
             ytdlp_v->url = YOUTUBE_URL_PREFIX + v->id;
             ytdlp_v->upload_date = "-";
-            ytdlp_v->live_status = "-";
+            ytdlp_v->live_status = YT_LIVE_STATUS::LIVE_STATUS_UNKNOWN;
             return ytdlp_v;
         }
 };
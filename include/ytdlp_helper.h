@@ -18,36 +18,150 @@
 #include <array>
 #include <exception>
 #include <stdio.h>
+#include <set>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <string_view>
+#include <memory>
 #include "fltube_utils.h"
 #include "cache.h"
+#include "ytdlp_worker.h"
+#include "json_parser.h"
+#include "process_manager.h"
+#include "thread_pool.h"
 
 
 /* Specify if the video is a normal video, a short video or a livestream video. */
 enum YT_VIDEO_TYPE { UNKNONW, VIDEO, SHORT, LIVESTREAM };
 
-/** Youtube video metadata. */
+/* Live status of a video, as reported by yt-dlp at the "live_status" field. */
+enum YT_LIVE_STATUS { LIVE_STATUS_UNKNOWN, NOT_LIVE, IS_LIVE, IS_UPCOMING, WAS_LIVE, POST_LIVE };
+
+// Value of a numeric metadata not reported by yt-dlp (i.e. the like count of a video with hidden likes).
+const long long METADATA_UNKNOWN_NUMBER = -1;
+
+// A video saved at the user lists (see userdata_manager.h).
+struct Video;
+
+/** Youtube video metadata. Numeric fields are parsed once, when the yt-dlp output is read. */
 struct YTDLP_Video_Metadata{
     std::string id;
     std::string title;
     std::string url;
     std::string upload_date;
     std::string creators;
-    std::string duration;
     std::string channel_id;
     std::string thumbnail_url;
-    std::string live_status;
-    std::string viewers_count;
+    long long duration = METADATA_UNKNOWN_NUMBER;     // In seconds.
+    YT_LIVE_STATUS live_status = YT_LIVE_STATUS::LIVE_STATUS_UNKNOWN;
+    long long viewers_count = METADATA_UNKNOWN_NUMBER;
     // For a more detailed metadata....
     std::string description = "NA";
-    std::string like_count = "NA";
-    std::string channel_follower_count = "NA";
+    long long like_count = METADATA_UNKNOWN_NUMBER;
+    long long channel_follower_count = METADATA_UNKNOWN_NUMBER;
     bool is_live = false;   // A livestream that has ended is now a regular video.
-    std::string concurrent_viewers_count;  // Concurrent viewers of a livestream, use only for DETAILED METADATA...
-    std::string timestamp = "NA";      //UTC Epoch time
+    long long concurrent_viewers_count = METADATA_UNKNOWN_NUMBER;  // Concurrent viewers of a livestream, use only for DETAILED METADATA...
+    long long timestamp = METADATA_UNKNOWN_NUMBER;      //UTC Epoch time
     std::string timestamp_text = "NA";
     YT_VIDEO_TYPE media_type = YT_VIDEO_TYPE::UNKNONW;     // Options are: video | short | livestream
     std::string category = "NA";
     std::vector<std::string> tags;
+
+    /* Returns the duration as "HH:MM:SS", or "NA" if unknown. */
+    std::string duration_text() const;
+
+    /* Returns this video as an entry of the user lists (History, Liked, Watch Later), with the views count and the
+     * duration (in seconds) written as the lists always stored them: "NA" if unknown. */
+    Video* to_video() const;
+
+    /* Approximate count of bytes used by this record, including the heap memory of its strings. */
+    size_t footprint() const;
+};
+
+/**
+ * Results of a search, in the same order printed by yt-dlp. The records are allocated at an arena that grows one search
+ * batch at a time, so a batch needs a single allocation, and pointers to the records stay valid while the object exists.
+ */
+class Search_Results {
+private:
+    std::vector<std::unique_ptr<YTDLP_Video_Metadata[]>> blocks;
+    size_t block_capacity = 0;
+    size_t block_used = 0;
+    std::vector<YTDLP_Video_Metadata*> records;
+
+public:
+    /* Allocate room for the next @count records (i.e. before loading a search batch). */
+    void reserve_batch(size_t count);
+
+    /* Move @metadata into the arena, after the last record. Returns the stored record. */
+    YTDLP_Video_Metadata* append(YTDLP_Video_Metadata&& metadata);
+
+    bool contains(std::string_view video_id) const;
+
+    size_t size() const {
+        return records.size();
+    }
+
+    YTDLP_Video_Metadata* at(size_t position) const {
+        return records[position];
+    }
+
+    /* Approximate count of bytes used by these results, including the unused room of the arena. */
+    size_t footprint() const;
+
+    /* True when a search batch returned less results than requested, so there are no more results to prefetch. */
+    bool exhausted = false;
+
+    /* Count of results added by the refresh of a persisted search, ahead of the results at their yt-dlp positions. */
+    size_t refreshed_count = 0;
+
+    /* Count of results printed by yt-dlp but not added, because they were already at these results (a search can
+     * return the same video at two batches). */
+    size_t repeated_count = 0;
+
+    /* Count of yt-dlp positions already retrieved, used to request the next search batch. */
+    size_t ytdlp_count() const {
+        return records.size() - std::min(refreshed_count, records.size()) + repeated_count;
+    }
+
+    /* Set the count of yt-dlp positions already retrieved (the rest of the results were added by a refresh). */
+    void set_ytdlp_count(size_t count) {
+        refreshed_count = records.size() - std::min(count, records.size());
+        repeated_count = count - std::min(count, records.size());
+    }
+};
+
+/* Policy of the search results cache: results never expire (pages being shown keep pointers to them), and their size is
+ * computed again every time a search batch is added. */
+struct Search_Cache_Policy: Default_Cache_Policy<std::string, std::shared_ptr<Search_Results>> {
+    static size_t footprint(const std::string& key, const std::shared_ptr<Search_Results>& results) {
+        return key.capacity() + results->footprint();
+    }
+};
+
+/* Metadata of a single video (retrieved by URL), and the date it must be retrieved again (i.e. its views count changed). */
+struct Cached_Video_Metadata {
+    std::shared_ptr<YTDLP_Video_Metadata> metadata;
+    time_t expiration = 0;
+};
+
+struct Video_Metadata_Cache_Policy {
+    static time_t expiration(const Cached_Video_Metadata& cached) {
+        return cached.expiration;
+    }
+
+    static bool is_valid(Cached_Video_Metadata& cached) {
+        return time(0) < cached.expiration;
+    }
+
+    static size_t footprint(const std::string& key, const Cached_Video_Metadata& cached) {
+        return key.capacity() + cached.metadata->footprint();
+    }
+
+    static void evicted(const std::string& key, Cached_Video_Metadata& cached) {}
 };
 
 /**
@@ -76,6 +190,13 @@ enum YT_METADATA_PROFILE {
     // Used when is required a detailed metadata view for a specific video.
     DETAILED };
 
+/* Format of the metadata printed by yt-dlp. */
+enum YT_METADATA_FORMAT {
+    // One JSON object per video (see @PRINT_SEARCH_METADATA_JSON_TEMPLATE), parsed with @JsonSaxParser.
+    METADATA_JSON,
+    // The legacy key="value">> template (see @PRINT_SEARCH_METADATA_TEMPLATE).
+    METADATA_TEXT };
+
 enum YTDLP_EXTRACTOR { YOUTUBE };
 
 /*  Used to define if a search is going to be by a search term, the videos from an specific channel or user,
@@ -83,6 +204,43 @@ enum YTDLP_EXTRACTOR { YOUTUBE };
  */
 enum SEARCH_BY_TYPE { TERM, CHANNEL_URL, VIDEO_URL };
 
+/* Handle of a search running at background (see YtDlp_Helper::search_async()). */
+class Search_Request {
+private:
+    std::shared_ptr<Cancellation_Token> token;
+    std::atomic<bool> finished;
+    yt_metadata_arr results;
+
+    friend class YtDlp_Helper;
+
+public:
+    Search_Request(): token(std::make_shared<Cancellation_Token>()), finished(false) {
+        results.fill(nullptr);
+    };
+
+    /* Stop the search, killing the yt-dlp process that is retrieving its results. A search batch that continues loading
+     * at background after the search finished is not affected. */
+    void cancel() {
+        if (!finished.load()) token->cancel();
+    }
+
+    bool is_cancelled() {
+        return token->is_cancelled();
+    }
+
+    bool is_finished() {
+        return finished.load();
+    }
+
+    /* Results of the search. Only valid once the search is finished and if it was not cancelled. */
+    const yt_metadata_arr& get_results() {
+        return results;
+    }
+};
+
+/* Called from the search thread once a @Search_Request finishes (even if it was cancelled). */
+typedef std::function<void(std::shared_ptr<Search_Request>)> search_done_handler;
+
 /*Enum for the target video resolutions. */
 enum VCODEC_RESOLUTIONS {
     R240p = 240, R360p = 360, R480p = 480, R720p = 720, R1080p = 1080 };
@@ -121,33 +279,205 @@ class YtDlp_Helper {
 
         YT_METADATA_PROFILE metadata_profile;
 
+        YT_METADATA_FORMAT metadata_format;
+
         std::shared_ptr<TerminalLogger> logger;
 
+        /* Launches every external program: yt-dlp (when no persistent worker is available), ffmpeg and the media player. */
+        ProcessManager process_manager;
+
+        /* Time limit (in milliseconds) for every yt-dlp call that retrieves metadata or stream URLs. 0 means no limit. */
+        unsigned int call_timeout_ms;
+
         std::shared_ptr<PermanentDiskCache> cache;
 
         unsigned int batch_search_size;
 
         std::string YTDLP_BIN_PATH;
 
-        // TODO: in the future, this must be a template T @GeneralCache, when implemented...
-        /* This is a simple results cache, with the following semantics:
-         *      map <"search term / channel ID <map <"video_id", parsed metadata>>>"  */
-        std::map<std::string, std::vector<std::pair<std::string, YTDLP_Video_Metadata*>>> search_cache;
+        /* Long-lived yt-dlp interpreters used to avoid the Python startup on every call. If nullptr, every call runs a new yt-dlp process. */
+        std::unique_ptr<YtDlp_Worker_Pool> worker_pool;
+
+        /* Application thread pool used for background searches. If nullptr, a new thread is started for every one. */
+        std::shared_ptr<ThreadPool> thread_pool;
+
+        /* This is a results cache, with the following semantics:
+         *      <"search term / channel ID", results in yt-dlp order>
+         * Bounded by @MAX_CACHED_SEARCHES and @MAX_SEARCH_CACHE_BYTES: the least recently used searches are evicted. */
+        GeneralCache<std::string, std::shared_ptr<Search_Results>, Search_Cache_Policy> search_cache;
+
+        /* Metadata of the videos searched by URL, by metadata profile and URL. Entries expire after @VIDEO_METADATA_TTL. */
+        GeneralCache<std::string, Cached_Video_Metadata, Video_Metadata_Cache_Policy> video_metadata_cache;
+
+        /* Directory where search results are persisted between sessions (empty disables it), seconds they remain valid,
+         * and if a search loaded from that directory is refreshed at background. */
+        std::string search_cache_dir;
+        unsigned int search_cache_ttl;
+        bool refresh_persisted_searches;
+        /* Serializes the writes of persisted search files. */
+        std::mutex persisted_search_mutex;
+
+        /* The latest results returned by searches, kept alive even if evicted from the caches, because the pages being
+         * shown keep pointers to them. Protected by @search_cache_mutex. */
+        std::deque<std::shared_ptr<void>> returned_results;
+
+        /* Protects the @search_cache results and @search_in_flight, because a search batch can be loaded at background. */
+        std::mutex search_cache_mutex;
+        /* Notified every time a new result is added to @search_cache, or a search batch finishes loading. */
+        std::condition_variable search_cache_updated;
+        /* Keys of @search_cache whose search batch is currently loading. */
+        std::set<std::string> search_in_flight;
+
+        /* If true, search results are parsed as soon as yt-dlp prints them, and a search returns once the requested page
+         * is available while the rest of the batch continues loading at background. */
+        bool streamed_search;
 
         /* List of alternative YouTube player client in case of default fails with HTTP 403 Forbidden code,
          * as defined in https://github.com/yt-dlp/yt-dlp#youtube. */
         std::vector<std::string> alt_player_clients;
 
+        /* Results of the streams made with every player client ("" is the yt-dlp default client), so the client that worked
+         * last is tried first. Saved at @player_client_scores_path, if not empty. */
+        struct Player_Client_Score {
+            unsigned long successes = 0;
+            unsigned long failures = 0;
+            time_t last_success = 0;
+            time_t last_failure = 0;
+        };
+        std::map<std::string, Player_Client_Score> player_client_scores;
+        std::string player_client_scores_path;
+        std::mutex player_client_mutex;
+        /* A save of the scores is queued and not started yet, so the scores recorded meanwhile are saved by it. Protected by
+         * @player_client_mutex. */
+        bool player_client_save_pending;
+        /* Serializes the writes of the scores file, which are made without @player_client_mutex locked. */
+        std::mutex player_client_file_mutex;
+
         /* When doing a search, a inner search history is saved, in order to recall previous searches results... */
         std::vector<std::string> search_history;
         int current_search_history_index;
 
-        /* Method to define the specific search parameters for Youtube Extractor, and make the videos search.  */
-        yt_metadata_arr do_youtube_search(const char* search_text, Pagination_Info page_info);
-
-        std::string get_stream_url(const char* video_url, const char* stream_format, bool& is_dash_format, std::vector<std::string> &urls, std::string alt_player_client = "");
-
-        std::vector<YTDLP_Video_Metadata*> retrieve_metadata(const char* search_text);
+        /* Serializes the searches, because they use the current @search_type and @metadata_profile. */
+        std::mutex search_mutex;
+        /* Count of searches started with search_async() and not finished yet. Protected by @search_cache_mutex. */
+        unsigned int running_searches;
+
+        /* When the user is within this count of pages from the end of the cached results, the next batch is loaded
+         * at background (speculative lane of @thread_pool). 0 disables the prefetch. */
+        unsigned int prefetch_lookahead_pages;
+        /* Keys of @search_cache whose prefetch task is queued but not started yet. A search that needs that batch
+         * claims it (removing the key), and loads it by itself instead of waiting for a speculative task. */
+        std::set<std::string> prefetch_queued;
+        /* Count of background tasks (search batch prefetch, stream URL resolution, the resolutions that lost a player
+         * client race, and the saves of the player client scores) queued or running.
+         * Protected by @search_cache_mutex. */
+        unsigned int speculative_tasks;
+        /* Shared by the background tasks of the current search (batch prefetch and refresh of a persisted search), that
+         * keep the token of the search they were started for. Cancelled, and replaced, when a different search starts
+         * (@prefetch_search_text) and on destruction. Protected by @search_cache_mutex. */
+        std::shared_ptr<Cancellation_Token> prefetch_token;
+        std::string prefetch_search_text;
+
+        /* Maximum count of videos of a page whose stream URL is resolved at background (0 disables it). */
+        unsigned int stream_url_prefetch_per_page;
+        /* Maximum count of stream URLs resolved at the same time. */
+        unsigned int stream_url_prefetch_concurrency;
+        /* Cancels the stream URL resolution of the previous page. Protected by @search_cache_mutex. */
+        std::shared_ptr<Cancellation_Token> stream_url_token;
+
+        /* Method to define the specific search parameters for Youtube Extractor, and make the videos search.
+         * If @token is cancelled, the search stops as soon as possible. */
+        yt_metadata_arr do_youtube_search(const char* search_text, Pagination_Info page_info, std::shared_ptr<Cancellation_Token> token);
+
+        /* Returns the cached results of a search, creating them if not cached. If @load_persisted is true, results not in
+         * memory are loaded from @search_cache_dir. @search_cache_mutex must be locked by the caller. */
+        std::shared_ptr<Search_Results> cached_search_results(const std::string& cache_key, bool load_persisted = false);
+
+        /* Key of a persisted search: the metadata profile and the search text. It reads the current @metadata_profile, so
+         * @search_mutex must be locked by the caller (background tasks receive the key computed by the search). */
+        std::string persisted_search_key(const std::string& search_text);
+        /* File of @search_cache_dir where the search with @persisted_key is saved. */
+        std::string persisted_search_path(const std::string& persisted_key);
+        /* Load the persisted results with @persisted_key into @results, if they exist and didn't expire. Returns true if loaded. */
+        bool load_persisted_search(const std::string& persisted_key, Search_Results& results);
+        /* Returns @results as the content of a persisted search file. @search_cache_mutex must be locked by the caller. */
+        std::string serialize_search(const std::string& persisted_key, const Search_Results& results);
+        /* Write a persisted search file (through a temporary file, so a reader never finds it partially written). */
+        void write_persisted_search(const std::string& persisted_key, const std::string& content);
+        /* Retrieve again the first batch of a search loaded from disk, and merge the new results (first) with the persisted ones. */
+        void refresh_persisted_search(const std::string cache_key, const std::string persisted_key, std::vector<std::string> ytdlp_args,
+                                      std::shared_ptr<Search_Results> persisted, std::shared_ptr<Cancellation_Token> token);
+        /* Remove the persisted searches that expired. */
+        void prune_persisted_searches();
+        /* A metadata record as the JSON object printed by @PRINT_SEARCH_METADATA_JSON_TEMPLATE. */
+        static std::string metadata_to_json(const YTDLP_Video_Metadata& metadata);
+
+        /* Keep @results alive while they could be shown (see @returned_results). @search_cache_mutex must be locked by the caller. */
+        void keep_returned_results(std::shared_ptr<void> results);
+
+        /* Same as search(), but @search_mutex must be locked by the caller. */
+        yt_metadata_arr run_search(const char* search_text_parameter, Pagination_Info page_info, std::shared_ptr<Cancellation_Token> token);
+
+        /* Returns the stream URL of @video_url from the URL cache or, if not cached, resolved by yt-dlp with @alt_player_client.
+         * If @from_cache is not null, it is set to true when the URL was cached (so yt-dlp didn't use that client). */
+        std::string get_stream_url(const char* video_url, const char* stream_format, bool& is_dash_format, std::vector<std::string> &urls,
+                                   std::string alt_player_client = "", Cancellation_Token* token = nullptr, bool* from_cache = nullptr);
+
+        /* The yt-dlp default client ("") and the alternative player clients: first the ones whose last stream succeeded (the
+         * latest success first), then the ones not used yet, and last the ones whose last stream failed. */
+        std::vector<std::string> player_clients_by_score();
+
+        /* Record the result of a stream URL resolved with @player_client, and save the scores at background (housekeeping
+         * lane of @thread_pool) if they are persisted. */
+        void record_player_client(const std::string& player_client, bool succeeded);
+
+        /* Write the current player client scores at @player_client_scores_path. */
+        void save_player_client_scores();
+
+        /* Resolve the stream URL of @video_url with every client at @player_clients at the same time, and keep the first one
+         * whose URL is accessible (the other resolutions are cancelled). Returns the access result of the chosen URL. */
+        FLTUBE_STATUS_CODES race_player_clients(const char* video_url, const char* stream_format, const std::vector<std::string>& player_clients,
+                                                std::string& final_url, bool& is_dash_format, std::vector<std::string>& urls);
+
+        /* yt-dlp format sort used to stream a video at the current @video_resolution. */
+        std::string stream_format_sort();
+
+        /* Background task for resolve_stream_urls(). */
+        void resolve_stream_urls_task(const std::vector<std::string> video_urls, std::shared_ptr<Cancellation_Token> token);
+
+        /* True if the stream URL of @video_url is not cached, or its cache entry expires within @STREAM_URL_REFRESH_AHEAD. */
+        bool needs_stream_url(const std::string& video_url);
+
+        std::vector<YTDLP_Video_Metadata*> retrieve_metadata(const std::vector<std::string>& ytdlp_args, Cancellation_Token* token = nullptr);
+
+        /* Retrieve a search batch with @ytdlp_args, appending every parsed result to the @search_cache entry for @cache_key
+         * as soon as it is printed, and then save the results with @persisted_key (computed when the batch is requested,
+         * since the metadata profile can change meanwhile). The @cache_key must be marked at @search_in_flight before
+         * call this method. */
+        void load_search_batch(const std::string cache_key, const std::string persisted_key, const std::vector<std::string> ytdlp_args,
+                               std::shared_ptr<Cancellation_Token> token);
+
+        /* Returns the yt-dlp arguments for the batch that follows the @cached_count results already cached for @search_text. */
+        std::vector<std::string> next_batch_args(const std::string& search_text, size_t cached_count);
+
+        /* Start the prefetch of the next batch for @search_text if the @page shown is near the end of the cached results
+         * (see @prefetch_lookahead_pages). @search_cache_mutex must be locked by the caller. */
+        void prefetch_next_batch(const std::string& search_text, Search_Results& results, const Pagination_Info& page);
+
+        /* Returns the yt-dlp arguments for retrieve the metadata of the results between @start and @end positions (both inclusive) of @target. */
+        std::vector<std::string> search_args(const std::string& target, int start, int end);
+
+        /* Run @task at the @lane of @thread_pool. Interactive tasks run at a new thread if there is no pool (or it is
+         * stopping). Returns false if the task was dropped. A task that waits for another one must not use this method to
+         * start it, since the interactive workers could all be busy. */
+        bool run_in_background(TASK_LANE lane, pool_task task);
+
+        /*  Run yt-dlp with the specified arguments and returns its output. A persistent worker is used if available,
+         *  otherwise a new yt-dlp process is executed. */
+        std::string run_ytdlp(const std::vector<std::string>& ytdlp_args, int& exit_status, Cancellation_Token* token = nullptr);
+
+        /*  Same as run_ytdlp(), but every output line is passed to @on_line as soon as yt-dlp prints it. */
+        void run_ytdlp(const std::vector<std::string>& ytdlp_args, const ytdlp_line_handler& on_line, int& exit_status, Cancellation_Token* token = nullptr);
 
     public:
         /** Current version of yt-dlp installed at the running system. If its value is -1, no version was detected... **/
@@ -156,11 +486,46 @@ class YtDlp_Helper {
         std::string PRINT_SEARCH_METADATA_TEMPLATE;
         /** Metadata print template for a detailed view of a specific youtube video.  **/
         std::string PRINT_DETAILED_METADATA_TEMPLATE;
+        /** Same as @PRINT_SEARCH_METADATA_TEMPLATE, but printing a single line JSON object.  **/
+        std::string PRINT_SEARCH_METADATA_JSON_TEMPLATE;
+        /** Same as @PRINT_DETAILED_METADATA_TEMPLATE, but printing a single line JSON object.  **/
+        std::string PRINT_DETAILED_METADATA_JSON_TEMPLATE;
 
         VCODEC_RESOLUTIONS video_resolution;
         YTDLP_EXTRACTOR extractor;
         const static int DEFAULT_MIN_BATCH_SIZE = 40;
         const static int DEFAULT_MAX_BATCH_SIZE = 200;
+        /* Default count of persistent yt-dlp workers, used if enabled at configuration. */
+        const static int DEFAULT_PERSISTENT_WORKERS = 1;
+        /* Default time limit (in seconds) for a yt-dlp call that retrieves metadata or stream URLs. */
+        const static int DEFAULT_CALL_TIMEOUT = 120;
+        /* Default count of pages before the end of the cached results that triggers the prefetch of the next batch. */
+        const static int DEFAULT_PREFETCH_LOOKAHEAD_PAGES = 1;
+        /* Default maximum count of videos of a page whose stream URL is resolved before the user clicks them. */
+        const static int DEFAULT_STREAM_URL_PREFETCH_PER_PAGE = PaginationManager::SEARCH_PAGE_SIZE;
+        /* Default maximum count of stream URLs resolved at the same time. */
+        const static int DEFAULT_STREAM_URL_PREFETCH_CONCURRENCY = 1;
+        /* Maximum count of videos whose stream URLs are resolved by a single yt-dlp run (see resolve_stream_urls_batch()),
+         * so every run finishes within the yt-dlp call timeout. */
+        const static int MAX_URLS_PER_BATCH = 10;
+        /* Seconds before the "expire" date of a stream URL when its cache entry expires, so a stream never starts with a dead URL. */
+        const static int STREAM_URL_EXPIRY_MARGIN = 5 * 60;
+        /* Cached stream URLs expiring within these seconds are resolved again when their video is shown (see resolve_stream_urls()). */
+        const static int STREAM_URL_REFRESH_AHEAD = 30 * 60;
+        /* Capacity of the search results cache: count of searches, and size in bytes. */
+        const static size_t MAX_CACHED_SEARCHES = 20;
+        const static size_t MAX_SEARCH_CACHE_BYTES = 32 * 1024 * 1024;
+        /* Capacity of the single video metadata cache, and seconds before its entries expire. */
+        const static size_t MAX_CACHED_VIDEO_METADATA = 100;
+        const static int VIDEO_METADATA_TTL = 10 * 60;
+        /* Default minutes a persisted search remains valid. */
+        const static int DEFAULT_SEARCH_CACHE_TTL_MINUTES = 6 * 60;
+        /* First line of a persisted search file, followed by its save date, exhausted flag and key. */
+        const static std::string PERSISTED_SEARCH_HEADER;
+        /* Count of search results kept alive after being returned (see @returned_results). */
+        const static size_t RETURNED_RESULTS_KEPT = 4;
+        /* Print template that writes, for every video, its input URL and its stream URLs (the second one only for DASH formats). */
+        const static std::string STREAM_URLS_PRINT_TEMPLATE;
         const static std::string DEFAULT_YTDLP_PATH;
         /* Alternative YouTube player client in case of default fails with HTTP 403 Forbidden code,
          * as defined in https://github.com/yt-dlp/yt-dlp#youtube. */
@@ -168,24 +533,32 @@ class YtDlp_Helper {
 
 
         YtDlp_Helper(VCODEC_RESOLUTIONS v_resolution, MediaPlayerInfo* mp, bool enable_alt_stream, std::shared_ptr<TerminalLogger> const& lgg, std::shared_ptr<PermanentDiskCache> const& cache, std::string working_dir, unsigned int batch_size, std::string ytdlp_path):
-            is_live_flag(false), video_resolution(v_resolution), media_player(mp), extractor(YTDLP_EXTRACTOR::YOUTUBE), enable_alternative_stream_method(enable_alt_stream), logger(lgg), cache(cache),
-            batch_search_size(batch_size), search_cache({}), search_history({}), current_search_history_index(0),
-            metadata_profile(YT_METADATA_PROFILE::SIMPLE)
+            is_live_flag(false), video_resolution(v_resolution), media_player(mp), extractor(YTDLP_EXTRACTOR::YOUTUBE), enable_alternative_stream_method(enable_alt_stream), logger(lgg),
+            process_manager(lgg), call_timeout_ms(DEFAULT_CALL_TIMEOUT * 1000), cache(cache), search_cache(1), video_metadata_cache(1),
+            search_cache_ttl(DEFAULT_SEARCH_CACHE_TTL_MINUTES * 60), refresh_persisted_searches(true),
+            batch_search_size(batch_size), player_client_save_pending(false), search_history({}), current_search_history_index(0),
+            metadata_profile(YT_METADATA_PROFILE::SIMPLE), metadata_format(YT_METADATA_FORMAT::METADATA_JSON), streamed_search(true),
+            running_searches(0), prefetch_lookahead_pages(DEFAULT_PREFETCH_LOOKAHEAD_PAGES), speculative_tasks(0),
+            prefetch_token(std::make_shared<Cancellation_Token>()),
+            stream_url_prefetch_per_page(DEFAULT_STREAM_URL_PREFETCH_PER_PAGE), stream_url_prefetch_concurrency(DEFAULT_STREAM_URL_PREFETCH_CONCURRENCY),
+            stream_url_token(std::make_shared<Cancellation_Token>())
             {
+                search_cache.set_capacity(MAX_CACHED_SEARCHES, MAX_SEARCH_CACHE_BYTES);
+                video_metadata_cache.set_capacity(MAX_CACHED_VIDEO_METADATA, 0);
                 if (ytdlp_path == "") {
                     YTDLP_BIN_PATH = DEFAULT_YTDLP_PATH;
                 } else {
                     YTDLP_BIN_PATH = ytdlp_path;
                 }
 
-                int exitStatus = 0;
-                char cmd[256];
-                snprintf(cmd, sizeof(cmd), "%s --version", YTDLP_BIN_PATH.c_str());
-                this->installed_version = exec(cmd, exitStatus);
-                if ( exitStatus == -1 ) {
-                    throw YtDlpInitException(_("Cannot execute yt-dlp command for some reason. Aborting..."));
-                } else if (exitStatus > 0) {
+                Process_Result version_result;
+                Process_Options version_options;
+                version_options.timeout_ms = call_timeout_ms;
+                this->installed_version = process_manager.run({ YTDLP_BIN_PATH, "--version" }, version_result, version_options);
+                if ( !version_result.spawned || version_result.exit_status > 0 ) {
                     throw YtDlpInitException(_("Check your yt-dlp installation. The 'yt-dlp' command is not found. Aborting..."));
+                } else if ( version_result.exit_status == -1 ) {
+                    throw YtDlpInitException(_("Cannot execute yt-dlp command for some reason. Aborting..."));
                 }
 
                 if (working_dir == "")
@@ -200,34 +573,60 @@ class YtDlp_Helper {
 
                 std::string dateFormat = _("%Y-%m-%d");
                 std::string fullDateFormat = _("%Y-%m-%d %H:%M:%S");
-                PRINT_SEARCH_METADATA_TEMPLATE = std::string("title=\\\"%(title)s\\\">>thumbnail=\\\"%(thumbnails.0.url)s" \
-                "\\\">>creators=\\\"%(uploader,playlist_channel)s\\\">>video_id=\\\"%(id)s\\\">>upload_date=\\\"%(upload_date>")
+                PRINT_SEARCH_METADATA_TEMPLATE = std::string("title=\"%(title)s\">>thumbnail=\"%(thumbnails.0.url)s" \
+                "\">>creators=\"%(uploader,playlist_channel)s\">>video_id=\"%(id)s\">>upload_date=\"%(upload_date>")
                 + dateFormat +
-                ")s\\\">>duration=\\\"%(duration>%H:%M:%S)s\\\">>channel_id=\\\"%(playlist_channel_id,channel_id)s\\\">>live_status=\\\"%(live_status)s\\\">>viewers_count=\\\"%(view_count,concurrent_view_count)s\\\">>";
+                ")s\">>duration=\"%(duration)s\">>channel_id=\"%(playlist_channel_id,channel_id)s\">>live_status=\"%(live_status)s\">>viewers_count=\"%(view_count,concurrent_view_count)s\">>";
 
                 PRINT_DETAILED_METADATA_TEMPLATE =
-                std::string("title=\\\"%(title)s\\\">>thumbnail=\\\"%(thumbnails.0.url)s" \
-                "\\\">>creators=\\\"%(uploader,playlist_channel)s\\\">>video_id=\\\"%(id)s\\\">>upload_date=\\\"%(upload_date>")
-                + dateFormat + ")s\\\">>duration=\\\"%(duration>%H:%M:%S)s\\\">>channel_id=\\\"%(playlist_channel_id,channel_id)s\\\">>is_live=\\\"%(is_live)s\\\">>viewers_count=\\\"%(view_count)s\\\">>concurrent_viewers_count=\\\"%(concurrent_view_count)s\\\">>timestamp=\\\"%(timestamp)s\\\">>timestamp_text=\\\"%(timestamp>"
+                std::string("title=\"%(title)s\">>thumbnail=\"%(thumbnails.0.url)s" \
+                "\">>creators=\"%(uploader,playlist_channel)s\">>video_id=\"%(id)s\">>upload_date=\"%(upload_date>")
+                + dateFormat + ")s\">>duration=\"%(duration)s\">>channel_id=\"%(playlist_channel_id,channel_id)s\">>is_live=\"%(is_live)s\">>viewers_count=\"%(view_count)s\">>concurrent_viewers_count=\"%(concurrent_view_count)s\">>timestamp=\"%(timestamp)s\">>timestamp_text=\"%(timestamp>"
+                + fullDateFormat +
+                ")s\">>media_type=\"%(media_type)s\">>followers=\"%(channel_follower_count)s\">>like_count=\"%(like_count)s\">>description=\"%(description)s\">>tags=\"%(tags)l\">>category=\"%(categories.0)s\">>";
+
+                // The JSON templates use the same keys than the text templates. Missing fields are printed as null ("|null").
+                PRINT_SEARCH_METADATA_JSON_TEMPLATE = std::string("{\"title\":%(title|null)j,\"thumbnail\":%(thumbnails.0.url|null)j," \
+                "\"creators\":%(uploader,playlist_channel|null)j,\"video_id\":%(id|null)j,\"upload_date\":%(upload_date>")
+                + dateFormat +
+                "|null)j,\"duration\":%(duration|null)j,\"channel_id\":%(playlist_channel_id,channel_id|null)j,\"live_status\":%(live_status|null)j,\"viewers_count\":%(view_count,concurrent_view_count|null)j}";
+
+                PRINT_DETAILED_METADATA_JSON_TEMPLATE =
+                std::string("{\"title\":%(title|null)j,\"thumbnail\":%(thumbnails.0.url|null)j," \
+                "\"creators\":%(uploader,playlist_channel|null)j,\"video_id\":%(id|null)j,\"upload_date\":%(upload_date>")
+                + dateFormat + "|null)j,\"duration\":%(duration|null)j,\"channel_id\":%(playlist_channel_id,channel_id|null)j,\"is_live\":%(is_live|null)j,\"viewers_count\":%(view_count|null)j,\"concurrent_viewers_count\":%(concurrent_view_count|null)j,\"timestamp\":%(timestamp|null)j,\"timestamp_text\":%(timestamp>"
                 + fullDateFormat +
-                ")s\\\">>media_type=\\\"%(media_type)s\\\">>followers=\\\"%(channel_follower_count)s\\\">>like_count=\\\"%(like_count)s\\\">>description=\\\"%(description)s\\\">>tags=\\\"%(tags)l\\\">>category=\\\"%(categories.0)s\\\">>";
+                "|null)j,\"media_type\":%(media_type|null)j,\"followers\":%(channel_follower_count|null)j,\"like_count\":%(like_count|null)j,\"description\":%(description|null)j,\"tags\":%(tags|null)j,\"category\":%(categories.0|null)j}";
 
             };
 
         ~YtDlp_Helper() {
-            for (auto& pair : search_cache) {
-                for (auto& pair2: pair.second) {
-                    if (pair2.second != nullptr) delete pair2.second;
-                }
-                pair.second.clear();
+            {
+                std::lock_guard<std::mutex> lock(search_cache_mutex);
+                prefetch_token->cancel();
+            }
+            cancel_stream_url_resolution();
+            {
+                // Wait for searches and search batches still loading at background...
+                std::unique_lock<std::mutex> lock(search_cache_mutex);
+                search_cache_updated.wait(lock, [this] { return search_in_flight.empty() && running_searches == 0 && speculative_tasks == 0; });
             }
             search_cache.clear();
+            worker_pool.reset();
             delete media_player;
         }
 
+        /*  Start @count persistent yt-dlp workers (see @YtDlp_Worker). Use 0 to run a new yt-dlp process on every call. */
+        void start_persistent_workers(unsigned int count);
+
         /*  Search one or more videos. This will be determined according to the type of search is configured. */
         yt_metadata_arr search(const char* search_text_parameter, Pagination_Info page_info);
 
+        /*  Same as search(), but the search runs at background using the @type and @profile specified, and @on_done is
+         *  called (from the search thread) when it finishes. The returned handle allows to cancel the search. */
+        std::shared_ptr<Search_Request> search_async(const char* search_text_parameter, Pagination_Info page_info, SEARCH_BY_TYPE type,
+                                                     YT_METADATA_PROFILE profile, search_done_handler on_done);
+
         /*  Start the streaming of an specific video URL. If the video is live, you should specify this before stream.
          *  If the default stream method is not working, stream using the alternative method (if configured this way). */
         FLTUBE_STATUS_CODES stream(const char* video_url);
@@ -237,6 +636,63 @@ class YtDlp_Helper {
             this->search_type = s;
         }
 
+        /* Change the time limit for yt-dlp calls that retrieve metadata or stream URLs. Use 0 for no limit. */
+        void set_call_timeout(unsigned int seconds) {
+            this->call_timeout_ms = seconds * 1000;
+        }
+
+        /* Change the count of pages before the end of the cached results that triggers a prefetch. Use 0 to disable it. */
+        void set_prefetch_lookahead(unsigned int pages) {
+            this->prefetch_lookahead_pages = pages;
+        }
+
+        /* Persist the search results at @dirname (created if missing), valid for @ttl_seconds. If @refresh is true, a search
+         * loaded from disk is refreshed at background. An empty @dirname, or a 0 @ttl_seconds, disables the persistence. */
+        void set_search_persistence(const std::string& dirname, unsigned int ttl_seconds, bool refresh);
+
+        /* Returns the counters of the search results and video metadata caches, one line by cache. */
+        std::string cache_stats_text() {
+            return format_cache_stats("Search results cache", search_cache.get_stats()) + "\n"
+                + format_cache_stats("Video metadata cache", video_metadata_cache.get_stats());
+        }
+
+        /* Write the counters of the search results and video metadata caches to the debug log. */
+        void log_cache_stats() {
+            logger->debug(format_cache_stats("Search results cache", search_cache.get_stats()));
+            logger->debug(format_cache_stats("Video metadata cache", video_metadata_cache.get_stats()));
+        }
+
+        /* Change the limits of the stream URL resolution (see resolve_stream_urls()). Use 0 @per_page to disable it. */
+        void set_stream_url_prefetch(unsigned int per_page, unsigned int concurrency) {
+            this->stream_url_prefetch_per_page = per_page;
+            this->stream_url_prefetch_concurrency = (concurrency > 0) ? concurrency : 1;
+        }
+
+        /* Resolve at background the stream URLs of @video_urls (the videos shown at the current page) and save them at the
+         * cache, so a later stream of any of them starts without waiting for yt-dlp. It cancels the resolution started for
+         * the previous page. */
+        void resolve_stream_urls(const std::vector<std::string>& video_urls);
+
+        /* Resolve the stream URLs of every video at @video_urls with a single yt-dlp run per @MAX_URLS_PER_BATCH videos,
+         * adding to the cache those that are accessible. Videos already cached (and not expiring soon) are skipped. Returns the count of URLs cached. */
+        size_t resolve_stream_urls_batch(const std::vector<std::string>& video_urls, Cancellation_Token* token = nullptr);
+
+        /* Returns the date when the cache entry of @final_url must expire: the earliest "expire" parameter of its URLs (both
+         * URLs of a DASH format) minus @STREAM_URL_EXPIRY_MARGIN, or 0 if no URL has that parameter. */
+        static time_t stream_url_expiration(const std::string& final_url);
+
+        /* Stop the stream URL resolution started by resolve_stream_urls(), if any. */
+        void cancel_stream_url_resolution();
+
+        void set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+            this->thread_pool = pool;
+        }
+
+        /* Enable or disable the streamed retrieval of search results (see @streamed_search). */
+        void set_streamed_search(bool enable) {
+            this->streamed_search = enable;
+        }
+
         void is_live(bool is_live = true) {
             this->is_live_flag = is_live;
         }
@@ -251,11 +707,19 @@ class YtDlp_Helper {
             this->video_resolution = res;
         }
 
+        /* Set the @YT_METADATA_FORMAT printed by yt-dlp, and parsed, in next video searches. */
+        void set_metadata_format(YT_METADATA_FORMAT format) {
+            this->metadata_format = format;
+        }
+
         /* Set the @YT_METADATA_PROFILE used in next video search. */
         void set_metadata_profile(YT_METADATA_PROFILE profile) {
             this->metadata_profile = profile;
         }
 
+        /* Load the player client scores from @path, and save them there every time they change. */
+        void set_player_client_scores_path(const std::string& path);
+
         void add_alt_player_client(std::string new_player) {
             if (new_player.empty()) return;
             if (std::find(alt_player_clients.begin(), alt_player_clients.end(), new_player) == alt_player_clients.end()) {
@@ -263,19 +727,34 @@ class YtDlp_Helper {
             }
         }
 
-        /* Returns the metadata template used when printing video metadata... Values available are:
-            @PRINT_SEARCH_METADATA_TEMPLATE and @PRINT_DETAILED_METADATA_TEMPLATE.    */
+        /* Returns the metadata template used when printing video metadata, according to the current @YT_METADATA_PROFILE
+            and @YT_METADATA_FORMAT (i.e. @PRINT_SEARCH_METADATA_TEMPLATE or @PRINT_DETAILED_METADATA_JSON_TEMPLATE).    */
         const std::string get_metadata_template();
 
+        /* Parse the output printed by @get_metadata_template() into @metadata, using the parser for the current
+         * @YT_METADATA_FORMAT. Returns false if the output cannot be parsed. */
+        bool parse_metadata_output(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata);
+
+        static void parse_metadata(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata);
+
+        /* Parse a single JSON object printed by a @PRINT_SEARCH_METADATA_JSON_TEMPLATE (or the DETAILED one). Returns false if it is not valid JSON. */
+        static bool parse_json_metadata(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata);
+
+        /* Parse an integer metadata value (decimals are truncated). Returns @METADATA_UNKNOWN_NUMBER if it's not a number (i.e. "NA"). */
+        static long long parse_metadata_number(std::string_view value);
+
+        /* Parse a duration in seconds ("212" or "212.5"), or as "[[HH:]MM:]SS". Returns @METADATA_UNKNOWN_NUMBER if not valid. */
+        static long long parse_duration(std::string_view value);
 
-        static YTDLP_Video_Metadata* parse_metadata(const char ytdlp_video_metadata[1024]);
+        /* Set the field of @metadata identified by @key (as named at the print templates) with @value. */
+        static void set_metadata_field(YTDLP_Video_Metadata* metadata, std::string_view key, std::string_view value);
 
         /* Returns a unique ID for the specified URL, taking into account the resolution configured for this instance of YtDlp_Helper. */
         std::string getIdFor(std::string video_url);
 
         void download_video(const char* video_url, const char* download_path, VCODEC_RESOLUTIONS v_resolution, const char* vcodec);
 
-        static std::string* get_metric_abbreviation(int number);
+        static std::string* get_metric_abbreviation(long long number);
 
         static bool isYoutubeURL(const char* url);
 
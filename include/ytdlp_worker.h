@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef YTDLP_WORKER_H
+#define YTDLP_WORKER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <chrono>
+#include <sys/types.h>
+#include "fltube_utils.h"
+
+/* Callback used to receive, line by line, the output printed by yt-dlp for a request. */
+typedef std::function<void(const std::string&)> ytdlp_line_handler;
+
+/* Result of a request sent to a persistent yt-dlp worker. */
+enum YTDLP_WORKER_RESULT {
+    // The request was served, and the yt-dlp exit status is available.
+    WRK_OK,
+    // The worker died (or never started) before answering the request.
+    WRK_CRASHED,
+    // The request cannot be sent to the worker (i.e. an argument contains a forbidden character).
+    WRK_REJECTED,
+    // The request exceeded its time limit, so the worker was terminated.
+    WRK_TIMEOUT
+};
+
+/**
+ * A long-lived Python interpreter with the "yt_dlp" module already imported, so the interpreter startup
+ * (1-2 seconds on old machines) is paid only once per session instead of once per yt-dlp call.
+ *
+ * Request/response framing over the worker's stdin/stdout:
+ *  - REQUEST: one line with the request ID and every yt-dlp argument, separated by @FIELD_SEPARATOR.
+ *  - RESPONSE: a "@RECORD_MARK FLTUBE_STARTED <id>" line once the request can be cancelled by a SIGINT, every line
+ *    printed by yt-dlp, and a "@RECORD_MARK FLTUBE_END <id> <exit_status>" line.
+ * The worker announces itself with a "@RECORD_MARK FLTUBE_READY <version>" line once yt_dlp was imported.
+ * The stderr of the worker is appended to the @errors_log_path file.
+ */
+class YtDlp_Worker {
+private:
+    std::string ytdlp_path;
+    std::string errors_log_path;
+    std::shared_ptr<TerminalLogger> logger;
+    pid_t pid;
+    int to_worker_fd;
+    int from_worker_fd;
+    bool ready;
+    unsigned long int last_request_id;
+    /* Bytes read from the worker stdout that don't form a complete line yet. */
+    std::string pending_output;
+    /* Time limit for the current request. */
+    std::chrono::steady_clock::time_point deadline;
+    bool deadline_exceeded;
+
+    /* Read the next complete line printed by the worker. Returns false if the worker closed its stdout, or if
+     * the @deadline was exceeded (then @deadline_exceeded is set). */
+    bool read_line(std::string& line);
+    /* Wait for the FLTUBE_READY line. Returns false if the worker cannot import yt_dlp. */
+    bool wait_until_ready();
+    /* Close pipes and reap the worker process. */
+    void reap();
+
+public:
+    static const char FIELD_SEPARATOR = '\x1f';
+    static const char RECORD_MARK = '\x1e';
+    /* Interpreter used to run the worker. yt-dlp itself requires Python 3. */
+    const static std::string PYTHON_INTERPRETER;
+
+    YtDlp_Worker(std::string ytdlp_path, std::string errors_log_path, std::shared_ptr<TerminalLogger> const& lgg):
+        ytdlp_path(ytdlp_path), errors_log_path(errors_log_path), logger(lgg), pid(-1), to_worker_fd(-1), from_worker_fd(-1),
+        ready(false), last_request_id(0), deadline(std::chrono::steady_clock::time_point::max()), deadline_exceeded(false) {};
+
+    ~YtDlp_Worker() {
+        stop();
+    }
+
+    /* Spawn the worker process. Returns true if the process was created (the yt_dlp import continues in background). */
+    bool start();
+
+    /* Close the worker stdin so it exits gracefully, and reap it. */
+    void stop();
+
+    bool is_running() {
+        return pid > 0;
+    }
+
+    pid_t get_pid() {
+        return pid;
+    }
+
+    /* Run yt-dlp with @args inside the worker. Every printed line is passed to @on_line, and the yt-dlp exit status
+     * is saved at @exit_status. If @token is cancelled, the request is interrupted with a SIGINT (the worker survives it).
+     * If the request takes more than @timeout_ms milliseconds (0 means no limit), the worker is terminated. */
+    YTDLP_WORKER_RESULT request(const std::vector<std::string>& args, const ytdlp_line_handler& on_line, int& exit_status,
+                                Cancellation_Token* token = nullptr, unsigned int timeout_ms = 0);
+};
+
+/**
+ * A fixed set of @YtDlp_Worker. A request takes any idle worker; if every worker is busy, the request is not served
+ * by the pool and the caller must fallback to a one-shot yt-dlp execution, so concurrent actions never wait for each other.
+ * A worker that crashes is restarted (and the request retried once) up to @MAX_CONSECUTIVE_CRASHES times, after that
+ * the pool disables itself.
+ */
+class YtDlp_Worker_Pool {
+private:
+    std::vector<std::unique_ptr<YtDlp_Worker>> workers;
+    std::vector<bool> busy;
+    std::mutex pool_mutex;
+    std::shared_ptr<TerminalLogger> logger;
+    unsigned int consecutive_crashes;
+    bool enabled;
+
+    /* Returns the index of an idle worker marked as busy, or -1 if no worker is available. */
+    int acquire();
+    void release(int index);
+
+public:
+    const static unsigned int MAX_CONSECUTIVE_CRASHES = 3;
+    const static unsigned int MAX_WORKERS = 4;
+
+    YtDlp_Worker_Pool(unsigned int count, std::string ytdlp_path, std::string errors_log_path, std::shared_ptr<TerminalLogger> const& lgg);
+
+    ~YtDlp_Worker_Pool();
+
+    bool is_enabled() {
+        return enabled;
+    }
+
+    /* Run a yt-dlp request using an idle worker. Returns false if the request was not served by the pool.
+     * A request that exceeds @timeout_ms is considered served, with an @exit_status of -1. */
+    bool run(const std::vector<std::string>& args, const ytdlp_line_handler& on_line, int& exit_status, Cancellation_Token* token = nullptr,
+             unsigned int timeout_ms = 0);
+};
+
+#endif
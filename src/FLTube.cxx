@@ -19,9 +19,14 @@
 #include "../include/configuration_manager.h"
 #include "../include/userdata_manager.h"
 #include "../include/cache.h"
+#include "../include/thread_pool.h"
+#include "../include/thumbnail_loader.h"
+#include "../include/thumbnail_store.h"
+#include "../include/thumbnail_decoder.h"
 #include <FL/Enumerations.H>
 #include <cstdio>
 #include <string>
+#include <set>
 
 /** Main Fltube window. */
 FLTubeMainWindow* mainWin =  (FLTubeMainWindow *)0;
@@ -95,10 +100,37 @@ ConfigurationManager* config = nullptr;
 
 UserDataManager* userdata = nullptr;
 
+/* Runs every background work of the application (streams, searches, prefetch...). */
+std::shared_ptr<ThreadPool> thread_pool = nullptr;
+
 std::shared_ptr<YtDlp_Helper> ytdlp = nullptr;
 
 std::shared_ptr<PermanentDiskCache> cache = nullptr;
 
+/* Thumbnails downloaded, by thumbnail URL, kept between sessions (at "<CACHE_PATH>/thumbnails"). */
+std::shared_ptr<ThumbnailStore> thumbnail_store = nullptr;
+
+/* Downloads at the same time the thumbnails of the page shown. A thumbnail is shown once downloaded (see thumbnail_loaded_cb()). */
+std::unique_ptr<ThumbnailLoader> thumbnail_loader = nullptr;
+/* Generation of the last ThumbnailLoader::load(), so a thumbnail downloaded for a page not shown anymore is discarded. */
+unsigned long thumbnails_generation = 0;
+/* Image shown while a thumbnail is downloaded. It is shared by every VideoInfo. */
+std::shared_ptr<Fl_Image> thumbnail_placeholder = nullptr;
+
+/* Thumbnails ready to draw, by "<video id>:<width>", so a page shown again doesn't decode them again. Only used at the
+ * FLTK main thread. */
+GeneralCache<std::string, std::shared_ptr<Fl_Image>, Decoded_Thumbnail_Policy> decoded_thumbnails(1);
+const size_t DEFAULT_DECODED_THUMBNAILS_MAX_KB = 4096;
+/* Every width a thumbnail was decoded to, so all the decoded copies of a thumbnail can be forgotten when it changes. */
+std::set<int> decoded_thumbnail_widths;
+/* Image shown at every VideoInfo, and at the detailed metadata window. They are kept while shown, even if evicted from
+ * @decoded_thumbnails. */
+std::array<std::shared_ptr<Fl_Image>, PaginationManager::SEARCH_PAGE_SIZE> shown_thumbnails;
+std::shared_ptr<Fl_Image> detailed_thumbnail = nullptr;
+
+/* Seconds between two removals of the expired entries of the URL cache. */
+const double CACHE_CLEANUP_INTERVAL = 60.0;
+
 PaginationManager* page_manager = nullptr;
 
 // First position keeps the "light" image version. Second position, the "dark" image version.
@@ -139,6 +171,13 @@ std::atomic<bool> SHOWING_LOADING_SCREEN_F(false);
 std::atomic<bool> SHOWING_LOADING_DETAILED_METADATA_F(false);
 
 std::atomic<bool> MESSAGE_PENDING(false);
+
+/* True while a search started by doSearch() runs at background. Unlike @ytdlp_action_in_progress, the UI keeps
+ * responding, so a new search (or a page change) can cancel it. */
+std::atomic<bool> search_in_progress(false);
+
+/* Last search started by doSearch(). Only accessed from the FLTK main thread. */
+std::shared_ptr<Search_Request> current_search;
 /**
  * Callback for main window close action. By default, exit app with success status code (0).
  */
@@ -155,6 +194,10 @@ void exitApp(unsigned short int exitStatusCode = FLT_OK) {
     if (message_window != nullptr) delete message_window;
     delete userdata;
     cache->finish();
+    for (const std::string& line: tokenize(cache_stats_report(), '\n')) logger->debug(line);
+    thumbnail_loader.reset();
+    thumbnail_store->save();
+    thread_pool->log_stats();
     delete page_manager;
     delete mainWin;
     delete config;
@@ -163,6 +206,17 @@ void exitApp(unsigned short int exitStatusCode = FLT_OK) {
     exit(exitStatusCode);
 }
 
+/**
+ * Returns the counters of every cache (URL, thumbnails, search results and video metadata), one line by cache.
+ */
+std::string cache_stats_report() {
+    std::string report = format_cache_stats("URL cache", cache->get_stats()) + "\n"
+        + format_cache_stats("Thumbnails cache", thumbnail_store->get_stats()) + "\n"
+        + format_cache_stats("Decoded thumbnails cache", decoded_thumbnails.get_stats());
+    if (ytdlp != nullptr) report += "\n" + ytdlp->cache_stats_text();
+    return report;
+}
+
 /**
  * Hide the target window.
  */
@@ -384,6 +438,17 @@ void check_forbidden_stream(void*)
     Fl::repeat_timeout(0.25, check_forbidden_stream);
 }
 
+/* Custom FLTK timeout to remove the expired entries of the URL cache, and to compact its journal when it grows. The work
+ * is done at the housekeeping lane of the thread pool, and only visits the expired entries.*/
+void cleanup_expired_cache(void*)
+{
+    thread_pool->submit(LANE_HOUSEKEEPING, []() {
+        cache->cleanup();
+        cache->compact_journal();
+    });
+    Fl::repeat_timeout(CACHE_CLEANUP_INTERVAL, cleanup_expired_cache);
+}
+
 /** Callback to preview a video... */
 void preview_video_cb(Fl_Button* widget, void* video_url){
     if (ytdlp_action_in_progress)
@@ -406,7 +471,7 @@ void preview_video_cb(Fl_Button* widget, void* video_url){
             replace_all(id, std::string(YOUTUBE_URL_PREFIX), "");
             for (YTDLP_Video_Metadata* ytv : video_metadata) {
                 if (ytv->id == id) {
-                    Video* v = new Video(id, ytv->title, ytv->creators, ytv->channel_id, ytv->viewers_count, ytv->duration, ytv->thumbnail_url);
+                    Video* v = ytv->to_video();
                     userdata->addVideo(v, UserDataManager::HISTORY_LIST_NAME);
                     break;
                 }
@@ -416,9 +481,10 @@ void preview_video_cb(Fl_Button* widget, void* video_url){
         char message[256];
         snprintf(message, sizeof(message), _("Starting streaming preview of video '%s' - (%s)..."), vi->title->label(), url->c_str());
         logger->info(message);
-        auto stream_lambda = [&](std::string* url, bool is_a_live) {
-            ytdlp_action_in_progress = true;
-
+        bool is_a_live = vi->is_live_image->visible();
+        // Set before the task starts, so the stream can't be requested twice while it waits for a worker.
+        ytdlp_action_in_progress = true;
+        thread_pool->submit(LANE_INTERACTIVE, [url, is_a_live]() {
             //TODO 'ytdlp' variable must be protected when using in other thread????????
             ytdlp->is_live(is_a_live);
             FLTUBE_STATUS_CODES stream_result;
@@ -431,11 +497,7 @@ void preview_video_cb(Fl_Button* widget, void* video_url){
             }
 
             ytdlp_action_in_progress = false;
-        };
-        // TODO: in the future, a ThreadPool of one or more threads could be implemented for optimization. More info at https://www.geeksforgeeks.org/cpp/thread-pool-in-cpp/.
-        std::thread worker(stream_lambda, url, vi->is_live_image->visible());
-
-        worker.detach();
+        });
     } else {
         logger->error(_("Cannot get video URL. Review the video metadata enabling app debugging..."));
     }
@@ -455,17 +517,18 @@ void clear_video_info() {
  */
 void update_video_info() {
     YTDLP_Video_Metadata* ytvm = nullptr;
+    std::vector<Thumbnail_Request> thumbnail_requests;
     char text_buffer[128];
     bool is_livestream;
     char* tabname = static_cast<char*>(mainWin->central_tabs->value()->user_data());
     bool displaying_video_list_tab = (tabname == TAB_VIDEOLIST_NAME);
     for (int j=0; j < video_metadata.size(); j++) {
       if (video_metadata[j] != nullptr) {
-            is_livestream = (video_metadata[j]->live_status == "is_live");
+            is_livestream = (video_metadata[j]->live_status == YT_LIVE_STATUS::IS_LIVE);
             video_info_arr[j]->show();
             video_info_arr[j]->title->label(video_metadata[j]->title.c_str());
             video_info_arr[j]->title->tooltip(video_metadata[j]->title.c_str());
-            video_info_arr[j]->duration->label(video_metadata[j]->duration.c_str());
+            video_info_arr[j]->duration->copy_label(video_metadata[j]->duration_text().c_str());
             video_info_arr[j]->uploadDate->label(video_metadata[j]->upload_date.c_str());
             video_info_arr[j]->userUploader->label(video_metadata[j]->creators.c_str());
             video_info_arr[j]->userUploader->user_data(static_cast<void*>(&video_metadata[j]->channel_id));
@@ -495,10 +558,11 @@ void update_video_info() {
             }
             video_info_arr[j]->watch_later_bttn->redraw();
             // Update Cache icon
-            if (cache->is_cached(ytdlp->getIdFor(video_metadata[j]->url))) {
+            Cache_Lookup cached_url = cache->peek(ytdlp->getIdFor(video_metadata[j]->url));
+            if (cached_url.found) {
                 char cache_tooltip[128];
                 std::snprintf(cache_tooltip, sizeof(cache_tooltip), _("Video URL Cached (valid until %s). Click to remove from cache."),
-                              cache->get_cache_expiration_date(ytdlp->getIdFor(video_metadata[j]->url)).c_str());
+                              URLCache::format_expiration(cached_url.expiration).c_str());
                 video_info_arr[j]->cache_bttn->copy_tooltip(cache_tooltip);
                 video_info_arr[j]->cache_bttn->show();
             } else {
@@ -512,13 +576,12 @@ void update_video_info() {
                 video_info_arr[j]->remove_bttn->hide();
                 video_info_arr[j]->remove_bttn->deactivate();
             }
-            try {
-                snprintf(text_buffer, sizeof(text_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(std::stoi(video_metadata[j]->viewers_count))->c_str(), (is_livestream) ? _("viewers") : _("views"));
-            } catch (const std::invalid_argument& ex) {
+            if (video_metadata[j]->viewers_count != METADATA_UNKNOWN_NUMBER) {
+                snprintf(text_buffer, sizeof(text_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(video_metadata[j]->viewers_count)->c_str(), (is_livestream) ? _("viewers") : _("views"));
+            } else {
                 char err_msg[256];
                 snprintf(err_msg, sizeof(err_msg), _("Error when getting count of viewers of video: (title: \"%s\", ID: \"%s\")"), video_metadata[j]->title.c_str(), video_metadata[j]->id.c_str());
                 logger->warn(err_msg);
-                logger->debug(ex.what());
                 strcpy(text_buffer, _("Unknown"));
             }
             video_info_arr[j]->views_spectators->copy_label(text_buffer);
@@ -530,22 +593,20 @@ void update_video_info() {
             if (cut_pos == std::string::npos)   cut_pos = video_metadata[j]->thumbnail_url.find("hqdefault.jpg?");
             std::string thumbn_url = video_metadata[j]->thumbnail_url.substr(0, cut_pos)
                 + ((cut_pos != std::string::npos) ? "mqdefault.jpg" : "");
-            std::string thumbn_name = "th_" + video_metadata[j]->id + ".jpg";
-            if (download_file(thumbn_url, FLTUBE_TEMPORAL_DIR, thumbn_name) != FLT_DOWNLOAD_FL_FAILED) {
-                int targetWidth = video_info_arr[j]->thumbnail->w();
-                Fl_Image* resized_thumbnail = create_resized_image_from_jpg(FLTUBE_TEMPORAL_DIR + thumbn_name, targetWidth);
-                if (resized_thumbnail == nullptr) {
-                    logger->error(_("Something went wrong when generating a resize thumbnail for video with ID=") + video_metadata[j]->id);
-                } else {
-                    delete video_info_arr[j]->thumbnail->image();
-                    video_info_arr[j]->thumbnail->image(resized_thumbnail);
-                    video_info_arr[j]->thumbnail->redraw();
+            Thumbnail_Request thumbn_request{ static_cast<size_t>(j), thumbn_url, thumbnail_store->path_for("th_" + video_metadata[j]->id + ".jpg") };
+            Thumbnail_File thumbn_file;
+            if (thumbnail_store->lookup(thumbn_url, thumbn_file)) {
+                show_thumbnail(j, thumbn_file.path);
+                // An old thumbnail is downloaded again, but only if it changed.
+                if (thumbnail_store->needs_revalidation(thumbn_file)) {
+                    thumbn_request.etag = thumbn_file.etag;
+                    thumbn_request.last_modified = thumbn_file.last_modified;
+                    thumbnail_requests.push_back(thumbn_request);
                 }
             } else {
-                //If thumbnail cannot be downloaded, then load a generic one...
-                Fl_PNG_Image* generic_thumbnail = load_resource_image("no_thumbnail_available.png");
-                video_info_arr[j]->thumbnail->image(generic_thumbnail);
-                video_info_arr[j]->thumbnail->redraw();
+                if (thumbnail_placeholder == nullptr) thumbnail_placeholder.reset(create_thumbnail_placeholder(video_info_arr[j]->thumbnail->w()));
+                set_thumbnail_image(j, thumbnail_placeholder);
+                thumbnail_requests.push_back(thumbn_request);
             }
 
         } else {
@@ -553,6 +614,116 @@ void update_video_info() {
             video_info_arr[j]->hide();
         }
     }
+
+    // Every thumbnail not saved (or too old) is downloaded at the same time. The downloads for the previous page are cancelled.
+    thumbnails_generation = thumbnail_loader->load(thumbnail_requests, [](const Thumbnail_Result& result) {
+        if (result.not_modified) {
+            thumbnail_store->revalidated(result.request.url);
+        } else if (result.downloaded) {
+            thumbnail_store->record_resolve_time(result.elapsed_ms);
+        }
+        // The thumbnail is decoded from memory, and saved at the thumbnails cache later (off the display path).
+        Fl::awake(thumbnail_loaded_cb, new Thumbnail_Result(result));
+        if (!result.downloaded || result.not_modified) return;
+        std::shared_ptr<ThumbnailStore> store = thumbnail_store;
+        Thumbnail_File thumbn_file{ result.request.output_path, result.bytes, result.etag, result.last_modified };
+        pool_task save_thumbnail = [store, url = result.request.url, thumbn_file, data = result.data]() {
+            store->save_thumbnail(url, thumbn_file, *data);
+        };
+        if (!thread_pool->submit(LANE_HOUSEKEEPING, save_thumbnail)) save_thumbnail();
+    });
+
+    // Resolve at background the stream URLs of the videos shown, so a click on any of them starts playing at once.
+    std::vector<std::string> stream_candidates;
+    for (YTDLP_Video_Metadata* vm : video_metadata) {
+        if (vm != nullptr && vm->live_status != YT_LIVE_STATUS::IS_LIVE && vm->live_status != YT_LIVE_STATUS::IS_UPCOMING) {
+            stream_candidates.push_back(vm->url);
+        }
+    }
+    ytdlp->resolve_stream_urls(stream_candidates);
+}
+
+/**
+ * Show @image at the VideoInfo at position @slot. The image shown before is deleted, unless it is still used (i.e. cached).
+ */
+void set_thumbnail_image(size_t slot, std::shared_ptr<Fl_Image> image) {
+    video_info_arr[slot]->thumbnail->image(image.get());
+    video_info_arr[slot]->thumbnail->redraw();
+    shown_thumbnails[slot] = std::move(image);
+}
+
+/**
+ * Returns the thumbnail of the video @video_id, saved at @thumbn_path, resized to @width. If @thumbn_data is not null, it
+ * is decoded from that JPEG data (i.e. just downloaded) instead of the file. Decoded thumbnails are cached, so only the
+ * first call for a thumbnail and width decodes it. Returns nullptr if the thumbnail cannot be loaded.
+ */
+std::shared_ptr<Fl_Image> get_decoded_thumbnail(const std::string& video_id, const std::string& thumbn_path, int width,
+                                                const std::string* thumbn_data) {
+    std::string key = video_id + ":" + std::to_string(width);
+    std::shared_ptr<Fl_Image> image;
+    if (decoded_thumbnails.get(key, image)) return image;
+    auto decode_start = std::chrono::steady_clock::now();
+    if (thumbn_data != nullptr) {
+        image.reset(decode_resized_jpeg(reinterpret_cast<const unsigned char*>(thumbn_data->data()), thumbn_data->size(), width));
+    } else {
+        image.reset(create_resized_image_from_jpg(thumbn_path, width));
+    }
+    if (image == nullptr) return nullptr;
+    decoded_thumbnails.record_resolve_time(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decode_start).count());
+    decoded_thumbnails.put(key, image);
+    decoded_thumbnail_widths.insert(width);
+    return image;
+}
+
+/**
+ * Remove from the decoded thumbnails cache every copy of the thumbnail of @video_id (i.e. because it was downloaded again).
+ */
+void forget_decoded_thumbnail(const std::string& video_id) {
+    for (int width: decoded_thumbnail_widths) decoded_thumbnails.remove(video_id + ":" + std::to_string(width));
+}
+
+/**
+ * Show at the VideoInfo at position @slot the thumbnail saved at @thumbn_path (or downloaded at @thumbn_data, if not null),
+ * resized to the thumbnail width. If the path is empty or the image cannot be loaded, a generic thumbnail is shown.
+ */
+void show_thumbnail(size_t slot, const std::string& thumbn_path, const std::string* thumbn_data) {
+    std::shared_ptr<Fl_Image> image = nullptr;
+    if (!thumbn_path.empty() && video_metadata[slot] != nullptr) {
+        image = get_decoded_thumbnail(video_metadata[slot]->id, thumbn_path, video_info_arr[slot]->thumbnail->w(), thumbn_data);
+        if (image == nullptr) {
+            logger->error(_("Something went wrong when generating a resize thumbnail for video with ID=") + video_metadata[slot]->id);
+        }
+    }
+    if (image == nullptr) {
+        //If thumbnail cannot be downloaded, then load a generic one...
+        image.reset(load_resource_image("no_thumbnail_available.png"));
+    }
+    set_thumbnail_image(slot, image);
+}
+
+/**
+ * Returns the image shown while a thumbnail is downloaded: the "loading" resource image, resized to @width.
+ */
+Fl_Image* create_thumbnail_placeholder(int width) {
+    Fl_PNG_Image* loading = load_resource_image("loading.png");
+    if (loading == nullptr) return nullptr;
+    Fl_Image* placeholder = loading->copy(width, ceil((loading->h() / static_cast<double>(loading->w())) * width));
+    delete loading;
+    return placeholder;
+}
+
+/**
+ * Called at the FLTK main thread (through Fl::awake) when a thumbnail download ends. The @data is a heap allocated
+ * Thumbnail_Result. Thumbnails requested for a page that is not shown anymore are discarded.
+ */
+void thumbnail_loaded_cb(void* data) {
+    std::unique_ptr<Thumbnail_Result> result(static_cast<Thumbnail_Result*>(data));
+    if (result->generation != thumbnails_generation || result->request.slot >= video_info_arr.size()) return;
+    // The thumbnail saved is already shown, and it is kept if it cannot be downloaded again.
+    if (result->not_modified || (!result->downloaded && result->request.is_conditional())) return;
+    // A thumbnail downloaded again can be different from the one decoded before.
+    if (result->downloaded && video_metadata[result->request.slot] != nullptr) forget_decoded_thumbnail(video_metadata[result->request.slot]->id);
+    show_thumbnail(result->request.slot, result->downloaded ? result->request.output_path : "", result->data.get());
 }
 
 /**
@@ -659,7 +830,7 @@ void markLikedVideo_cb(Fl_Widget *wdg) {
                 userdata->removeVideoFromList(ytv->id, UserDataManager::LIKED_LIST_NAME);
                 vi->like_icon_bttn->image(like_icon_image);
             } else {
-                Video* v = new Video(id, ytv->title, ytv->creators, ytv->channel_id, ytv->viewers_count, ytv->duration, ytv->thumbnail_url);
+                Video* v = ytv->to_video();
                 userdata->addVideo(v, UserDataManager::LIKED_LIST_NAME);
                 vi->like_icon_bttn->image(like_red_icon_image);
             }
@@ -678,7 +849,7 @@ void add_to_watch_later(Fl_Widget *wdg) {
                 userdata->removeVideoFromList(ytv->id, UserDataManager::WATCHLATER_LIST_NAME);
                 vi->watch_later_bttn->image(watchlater_icon_image);
             } else {
-                Video* v = new Video(id, ytv->title, ytv->creators, ytv->channel_id, ytv->viewers_count, ytv->duration, ytv->thumbnail_url);
+                Video* v = ytv->to_video();
                 userdata->addVideo(v, UserDataManager::WATCHLATER_LIST_NAME);
                 vi->watch_later_bttn->image(watchlater_filled_icon_image);
             }
@@ -691,10 +862,12 @@ void removeFromCache_cb(Fl_Widget *wdg) {
     VideoInfo* vi = static_cast<VideoInfo*>(wdg->parent());
     //Registering view of current video at History List...
     std::string video_url = *static_cast<std::string*>(vi->thumbnail->user_data());
-    if (cache->is_cached(ytdlp->getIdFor(video_url))) {
+    std::string cache_id = ytdlp->getIdFor(video_url);
+    Cache_Lookup cached_url = cache->peek(cache_id);
+    if (cached_url.found) {
         char mssg[256];
-        snprintf(mssg, sizeof(mssg), _("The following cache was invalidated by user request: id=%s; expiration_date=%s."), ytdlp->getIdFor(video_url).c_str(), cache->get_cache_expiration_date(ytdlp->getIdFor(video_url)).c_str());
-        if (cache->remove_entry(ytdlp->getIdFor(video_url))) logger->debug(mssg);
+        snprintf(mssg, sizeof(mssg), _("The following cache was invalidated by user request: id=%s; expiration_date=%s."), cache_id.c_str(), URLCache::format_expiration(cached_url.expiration).c_str());
+        if (cache->remove_entry(cache_id)) logger->debug(mssg);
     }
     wdg->hide();
 }
@@ -894,33 +1067,27 @@ void show_video_metadata_cb(Fl_Widget* w, void* data) {
     replace_all(v_id, std::string(YOUTUBE_URL_PREFIX), "");
     std::string thumbn_name = "th_" + v_id + ".jpg";
     int targetWidth = detailed_metadata_win->vm_thumbnail->w();
-    Fl_Image* resized_thumbnail = create_resized_image_from_jpg(FLTUBE_TEMPORAL_DIR + thumbn_name, targetWidth);
-    delete detailed_metadata_win->vm_thumbnail->image();
-    if (resized_thumbnail != nullptr) {
-        detailed_metadata_win->vm_thumbnail->image(resized_thumbnail);
-    }
+    std::shared_ptr<Fl_Image> resized_thumbnail = get_decoded_thumbnail(v_id, thumbnail_store->path_for(thumbn_name), targetWidth);
+    detailed_metadata_win->vm_thumbnail->image(resized_thumbnail.get());
     detailed_metadata_win->vm_thumbnail->redraw();
+    detailed_thumbnail = resized_thumbnail;
     detailed_metadata_win->delete_all_metadata();
     detailed_metadata_win->vm_retrieving_info->show();
     detailed_metadata_win->show();
 
-    ytdlp->set_search_type(SEARCH_BY_TYPE::VIDEO_URL);
-    ytdlp->set_metadata_profile(YT_METADATA_PROFILE::DETAILED);
-
     SHOWING_LOADING_DETAILED_METADATA_F = true;
-    auto stream_lambda = [&]() {
-        ytdlp_action_in_progress = true;
-        video_metadata = ytdlp->search(v_url.c_str(), Pagination_Info(1,0));
-        ytdlp_action_in_progress = false;
-        SHOWING_LOADING_DETAILED_METADATA_F = false;
-
-    };
-    std::thread worker(stream_lambda);
-    worker.detach();
+    ytdlp_action_in_progress = true;
+    std::shared_ptr<Search_Request> detailed_search = ytdlp->search_async(v_url.c_str(), Pagination_Info(1,0), SEARCH_BY_TYPE::VIDEO_URL,
+        YT_METADATA_PROFILE::DETAILED, [](std::shared_ptr<Search_Request> request) {
+            SHOWING_LOADING_DETAILED_METADATA_F = false;
+            Fl::awake();
+        });
 
     while (SHOWING_LOADING_DETAILED_METADATA_F) {
         Fl::check();
     }
+    video_metadata = detailed_search->get_results();
+    ytdlp_action_in_progress = false;
 
     detailed_metadata_win->vm_retrieving_info->hide();
     YTDLP_Video_Metadata* vm = video_metadata[0];
@@ -931,7 +1098,7 @@ void show_video_metadata_cb(Fl_Widget* w, void* data) {
 
     char tiny_buffer[128];
     detailed_metadata_win->add_metadata(_("Title"), vm->title);
-    int follower_counts = isNumber(vm->channel_follower_count) ? std::stoi(vm->channel_follower_count) : 0;
+    long long follower_counts = std::max(vm->channel_follower_count, 0LL);
     detailed_metadata_win->add_metadata(_("Creator"), vm->creators + " (" + YtDlp_Helper::get_metric_abbreviation(follower_counts)->c_str() + " " + _("followers") + ")");
     detailed_metadata_win->add_metadata(_("Upload Date"), vm->timestamp_text);  //TODO create a localized datetime from the original timestamp
     std::string media_type_str;
@@ -953,14 +1120,14 @@ void show_video_metadata_cb(Fl_Widget* w, void* data) {
     detailed_metadata_win->add_metadata(_("Video Type"), media_type_str);
     detailed_metadata_win->add_metadata(_("Category"), _(vm->category.c_str()));
     if (vm->media_type != YT_VIDEO_TYPE::LIVESTREAM ||
-        (vm->media_type == YT_VIDEO_TYPE::LIVESTREAM && !vm->is_live)) detailed_metadata_win->add_metadata(_("Duration"), vm->duration);
+        (vm->media_type == YT_VIDEO_TYPE::LIVESTREAM && !vm->is_live)) detailed_metadata_win->add_metadata(_("Duration"), vm->duration_text());
     if (vm->media_type == YT_VIDEO_TYPE::LIVESTREAM && vm->is_live) {
-        snprintf(tiny_buffer, sizeof(tiny_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(std::stoi(vm->concurrent_viewers_count))->c_str(), _("viewers"));
+        snprintf(tiny_buffer, sizeof(tiny_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(std::max(vm->concurrent_viewers_count, 0LL))->c_str(), _("viewers"));
     } else {
-        snprintf(tiny_buffer, sizeof(tiny_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(std::stoi(vm->viewers_count))->c_str(), _("views"));
+        snprintf(tiny_buffer, sizeof(tiny_buffer), "%s %s", YtDlp_Helper::get_metric_abbreviation(std::max(vm->viewers_count, 0LL))->c_str(), _("views"));
     }
     detailed_metadata_win->add_metadata(_("Views Count"), tiny_buffer);
-    int like_count = isNumber(vm->like_count) ? std::stoi(vm->like_count) : 0;
+    long long like_count = std::max(vm->like_count, 0LL);
     detailed_metadata_win->add_metadata(_("Like Count"), YtDlp_Helper::get_metric_abbreviation(like_count)->c_str());
 
     detailed_metadata_win->add_metadata(_("Original URL"), vm->url);
@@ -996,7 +1163,22 @@ void pre_init() {
     std::string default_cache_path = std::string(getHomePathOr("")) + "/.cache/fltube";
     cache->set_save_directory_path(
         config->getProperty("CACHE_PATH", default_cache_path.c_str()), "fltube_url_cache.txt");
+    int cache_max_entries = config->getIntProperty("URL_CACHE_MAX_ENTRIES", URLCache::DEFAULT_MAX_ENTRIES);
+    int cache_max_kb = config->getIntProperty("URL_CACHE_MAX_SIZE_KB", URLCache::DEFAULT_MAX_BYTES / 1024);
+    cache->set_capacity((cache_max_entries > 0) ? cache_max_entries : 0, (cache_max_kb > 0) ? cache_max_kb * 1024 : 0);
+    if (config->getProperty("URL_CACHE_FILE_FORMAT", "TEXT") == "BINARY") {
+        cache->set_file_format(CACHE_FILE_FORMAT::BINARY_FORMAT);
+    }
     cache->init();
+    int decoded_thumbnails_max_kb = config->getIntProperty("THUMBNAIL_MEMORY_CACHE_MAX_SIZE_KB", DEFAULT_DECODED_THUMBNAILS_MAX_KB);
+    decoded_thumbnails.set_capacity(0, (decoded_thumbnails_max_kb > 0) ? static_cast<size_t>(decoded_thumbnails_max_kb) * 1024 : 0);
+    thumbnail_store = std::make_shared<ThumbnailStore>(logger);
+    int thumbnails_max_mb = config->getIntProperty("THUMBNAIL_CACHE_MAX_SIZE_MB", ThumbnailStore::DEFAULT_MAX_SIZE_MB);
+    size_t thumbnails_max_bytes = (thumbnails_max_mb > 0) ? static_cast<size_t>(thumbnails_max_mb) * 1024 * 1024 : 0;
+    // If the cache directory cannot be used, the thumbnails are only kept during this session.
+    if (!thumbnail_store->open(config->getProperty("CACHE_PATH", default_cache_path.c_str()) + "/thumbnails", thumbnails_max_bytes)) {
+        thumbnail_store->open(FLTUBE_TEMPORAL_DIR, thumbnails_max_bytes);
+    }
     //Init Localization. Use locale path specified at config, or custom config default_locale_path().
     setup_gettext("", config->getProperty("LOCALE_PATH", default_locale_path().c_str()));
 
@@ -1049,6 +1231,7 @@ void pre_init() {
     try {
         ytdlp = std::make_shared<YtDlp_Helper>(STREAM_VIDEO_RESOLUTION, media_player, enable_alt_stream, logger, cache, FLTUBE_TEMPORAL_DIR, batch_size, ytdlp_path);
         logger->debug("yt-dlp version detected at your system: " + ytdlp->installed_version);
+        ytdlp->set_thread_pool(thread_pool);
     } catch (const YtDlpInitException& e) {
         logger->error(e.what());
         return;
@@ -1056,6 +1239,24 @@ void pre_init() {
 
     auto props = config->getListsProperty("ALTERNATIVE_YT_PLAYER_LIST", YtDlp_Helper::ALTERN_YT_PLAYER_CLIENT.c_str());
     for (auto prop : props) ytdlp->add_alt_player_client(prop);
+    if (config->getBoolProperty("REMEMBER_YT_PLAYER_CLIENT", true)) {
+        ytdlp->set_player_client_scores_path(config->getProperty("CACHE_PATH", default_cache_path.c_str()) + "/player_clients.txt");
+    }
+    ytdlp->set_streamed_search(config->getBoolProperty("ENABLE_STREAMED_SEARCH_RESULTS", true));
+    int prefetch_pages = config->getIntProperty("PREFETCH_LOOKAHEAD_PAGES", YtDlp_Helper::DEFAULT_PREFETCH_LOOKAHEAD_PAGES);
+    ytdlp->set_prefetch_lookahead((prefetch_pages > 0) ? prefetch_pages : 0);
+    int stream_url_prefetch = config->getIntProperty("STREAM_URL_PREFETCH_PER_PAGE", YtDlp_Helper::DEFAULT_STREAM_URL_PREFETCH_PER_PAGE);
+    int stream_url_concurrency = config->getIntProperty("STREAM_URL_PREFETCH_CONCURRENCY", YtDlp_Helper::DEFAULT_STREAM_URL_PREFETCH_CONCURRENCY);
+    ytdlp->set_stream_url_prefetch((stream_url_prefetch > 0) ? stream_url_prefetch : 0, (stream_url_concurrency > 0) ? stream_url_concurrency : 1);
+    if (config->getProperty("METADATA_OUTPUT_FORMAT", "JSON") == "TEXT") {
+        logger->debug(_("Using the legacy text template to retrieve videos metadata."));
+        ytdlp->set_metadata_format(YT_METADATA_FORMAT::METADATA_TEXT);
+    }
+    int call_timeout = config->getIntProperty("YTDLP_CALL_TIMEOUT", YtDlp_Helper::DEFAULT_CALL_TIMEOUT);
+    ytdlp->set_call_timeout((call_timeout > 0) ? call_timeout : 0);
+    int search_cache_ttl = config->getIntProperty("SEARCH_CACHE_TTL", YtDlp_Helper::DEFAULT_SEARCH_CACHE_TTL_MINUTES);
+    ytdlp->set_search_persistence(config->getProperty("CACHE_PATH", default_cache_path.c_str()) + "/searches",
+                                  (search_cache_ttl > 0) ? search_cache_ttl * 60 : 0, config->getBoolProperty("SEARCH_CACHE_REFRESH", true));
 
     initial_win->loading_about_data->label(_("Loading resources files..."));
     live_image = load_resource_image("livebutton_18p.png");
@@ -1085,6 +1286,12 @@ void pre_init() {
     std::filesystem::create_directory(FLTUBE_TEMPORAL_DIR);
     std::filesystem::current_path(FLTUBE_TEMPORAL_DIR);
 
+    // Persistent yt-dlp workers log their errors at the temporal directory, so must be started after its creation.
+    if (config->getBoolProperty("ENABLE_YTDLP_PERSISTENT_WORKERS", true)) {
+        int workers_count = config->getIntProperty("YTDLP_PERSISTENT_WORKERS_COUNT", YtDlp_Helper::DEFAULT_PERSISTENT_WORKERS);
+        ytdlp->start_persistent_workers((workers_count > 0) ? workers_count : 0);
+    }
+
     // Add a custom FLTK event dispatcher
     Fl::event_dispatch([](int event, Fl_Window* w) -> int{
         //TODO Modify atomic variables access syntax using "load" or "store" functions, so is better to understand the real concurrence action...
@@ -1101,6 +1308,9 @@ void pre_init() {
                 case FL_MOUSEWHEEL:
                     return 1;       // Ignore this events when streaming in course...
             }
+        } else if (search_in_progress) {
+            // A background search doesn't block the UI, so a new search can cancel it...
+            change_cursor(FL_CURSOR_WAIT);
         } else {
             if (current_displayed_cursor != FL_CURSOR_DEFAULT) {
                 lock_buttons(false);
@@ -1113,10 +1323,12 @@ void pre_init() {
                     if (video_url != nullptr && userdata->getHistoryList()->findVideoById(id) != nullptr) {
                         video_selected_for_stream->already_viewed_icon->show();
                     }
-                    if (video_url != nullptr && cache->is_cached(ytdlp->getIdFor(video_url->c_str()))) {
+                    Cache_Lookup cached_url;
+                    if (video_url != nullptr) cached_url = cache->peek(ytdlp->getIdFor(*video_url));
+                    if (cached_url.found) {
                         char cache_tooltip[128];
                         std::snprintf(cache_tooltip, sizeof(cache_tooltip), _("Video URL Cached (valid until %s). Click to remove from cache."),
-                                      cache->get_cache_expiration_date(ytdlp->getIdFor(video_url->c_str())).c_str());
+                                      URLCache::format_expiration(cached_url.expiration).c_str());
                         video_selected_for_stream->cache_bttn->copy_tooltip(cache_tooltip);
                         video_selected_for_stream->cache_bttn->show();
                     }
@@ -1181,6 +1393,12 @@ void post_init() {
         cache->remove_all_entries();
         logger->debug(_("All cache entries were deleted by user demand..."));
     });
+    mainWin->cache_stats_bttn->callback([](Fl_Widget* w, void* data) {
+        std::string report = cache_stats_report();
+        logger->debug(report);
+        fl_message_title(_("Cache statistics"));
+        fl_message("%s", report.c_str());
+    });
     mainWin->cache_pause_bttn->callback([](Fl_Widget* w, void* data) {
         if (cache->change_status(CACHE_RECORD_STATUS::STOPPED)) {
             mainWin->cache_pause_bttn->hide();
@@ -1268,6 +1486,7 @@ void post_init() {
 
     /// FLTK CUSTOM TIMEOUT CALLBACKS
     Fl::add_timeout(0.25, check_forbidden_stream);
+    Fl::add_timeout(CACHE_CLEANUP_INTERVAL, cleanup_expired_cache);
 
     // Redraw the window to show the new button
     mainWin->redraw();
@@ -1295,17 +1514,53 @@ VideoInfo* create_video_group(int posx, int posy) {
     return video_info;
 }
 
+/**
+ * Called at the FLTK main thread (through Fl::awake) when a search started by doSearch() finishes. The @data is a
+ * heap allocated std::shared_ptr<Search_Request>.
+ */
+void search_done_cb(void* data) {
+    std::shared_ptr<Search_Request>* request_ptr = static_cast<std::shared_ptr<Search_Request>*>(data);
+    std::shared_ptr<Search_Request> request = *request_ptr;
+    delete request_ptr;
+    // Results of a search pre-empted by a newer one are discarded...
+    if (request != current_search || request->is_cancelled()) return;
+    current_search = nullptr;
+
+    video_metadata = request->get_results();
+    bool is_empty_metadata = std::all_of(video_metadata.begin(), video_metadata.end(),
+                                         [](YTDLP_Video_Metadata* ptr) { return ptr == nullptr; });
+    bool are_more_results = std::none_of(video_metadata.begin(), video_metadata.end(),
+                                         [](YTDLP_Video_Metadata* ptr) { return ptr == nullptr; });
+    if (!is_empty_metadata)  {
+        update_video_info();
+    }
+    if (!are_more_results) {
+        page_manager->limit(true);
+        page_manager->set_max_results(page_manager->current().upper_end());
+        mainWin->next_results_bttn->deactivate();
+        mainWin->last_page_bttn->deactivate();
+    }
+    //Restore cursor to default when search is done.
+    search_in_progress = false;
+    change_cursor();
+}
+
 /**
  * Search by YT URL or search term. Or if "is_a_channel" is set, then return videos from channel URL specified at "input_text".
+ * The search runs at background, and a search still running is cancelled. The results are shown by search_done_cb().
  */
 void doSearch(const char* input_text) {
+    if (current_search != nullptr) {
+        current_search->cancel();
+        current_search = nullptr;
+    }
     //Change cursor to wait symbol, to indicate that the search is in process...
-    ytdlp_action_in_progress = true;
+    search_in_progress = true;
     change_cursor(FL_CURSOR_WAIT);
     // Check if there is Internet connectivity before do a search...
     if (! verify_network_connection()) {
         //Restore cursor after search failed because no Internet is available...
-        ytdlp_action_in_progress = false;
+        search_in_progress = false;
         change_cursor();
         logger->warn(_("Your device is offline. Check your internet connection."));
         showMessageWindow( _("There seems that you don't have access to the Internet. "
@@ -1316,17 +1571,18 @@ void doSearch(const char* input_text) {
     char message[1024];
     snprintf(message, sizeof(message), _("Searching for results for '%s' user input..."), input_text);
     logger->debug(std::string(message));
+    SEARCH_BY_TYPE search_type;
     if (isUrl(input_text) && !SEARCH_BY_CHANNEL_F) {
         if(!YtDlp_Helper::isYoutubeURL(input_text)){
             //Restore cursor after search failed because no Internet is available...
-            ytdlp_action_in_progress = false;
+            search_in_progress = false;
             change_cursor();
             std::string warn_message = _("For now, only Youtube URL's are valid for download. Please, edit your input text or search using a generic term.");
             showMessageWindow(warn_message.c_str());
             logger->warn(warn_message);
             return;
         }
-        ytdlp->set_search_type(SEARCH_BY_TYPE::VIDEO_URL);
+        search_type = SEARCH_BY_TYPE::VIDEO_URL;
         page_manager->reset();
         page_manager->limit(true);
         page_manager->set_max_results(1);
@@ -1335,24 +1591,12 @@ void doSearch(const char* input_text) {
         if (page_manager->current().index == 0) {
             mainWin->next_results_bttn->activate();
         }
-        ytdlp->set_search_type( (SEARCH_BY_CHANNEL_F) ? SEARCH_BY_TYPE::CHANNEL_URL : SEARCH_BY_TYPE::TERM);
+        search_type = (SEARCH_BY_CHANNEL_F) ? SEARCH_BY_TYPE::CHANNEL_URL : SEARCH_BY_TYPE::TERM;
     }
-    ytdlp->set_metadata_profile(YT_METADATA_PROFILE::SIMPLE);
-    video_metadata = ytdlp->search(input_text, page_manager->current());
-    bool is_empty_metadata = std::all_of(video_metadata.begin(), video_metadata.end(),
-                                         [](YTDLP_Video_Metadata* ptr) { return ptr == nullptr; });
-    bool are_more_results = std::none_of(video_metadata.begin(), video_metadata.end(),
-                                         [](YTDLP_Video_Metadata* ptr) { return ptr == nullptr; });
-    if (!is_empty_metadata)  {
-        update_video_info();
-    }
-    if (!are_more_results) {
-        page_manager->limit(true);
-        page_manager->set_max_results(page_manager->current().upper_end());
-    }
-    //Restore cursor to default when search is done.
-    ytdlp_action_in_progress = false;
-    change_cursor();
+    current_search = ytdlp->search_async(input_text, page_manager->current(), search_type, YT_METADATA_PROFILE::SIMPLE,
+        [](std::shared_ptr<Search_Request> request) {
+            Fl::awake(search_done_cb, new std::shared_ptr<Search_Request>(request));
+        });
 }
 
 // Callback for moving backward or forward the search value in history.
@@ -1569,6 +1813,8 @@ void parseOptions(int argc, char **argv){
 int main(int argc, char **argv) {
     parseOptions(argc, argv);
     logger = std::make_shared<TerminalLogger>(DEBUG_ENABLED);
+    // Enable the FLTK multithreading support, required to deliver the results of background searches with Fl::awake().
+    Fl::lock();
     showInitialWindow();
     auto preinit_f = [&]() {
         pre_init();
@@ -1576,8 +1822,9 @@ int main(int argc, char **argv) {
             SHOWING_LOADING_SCREEN_F = false;
         }
     };
-    std::thread worker(preinit_f);
-    worker.detach();
+    thread_pool = std::make_shared<ThreadPool>(logger);
+    thumbnail_loader = std::make_unique<ThumbnailLoader>(logger);
+    thread_pool->submit(LANE_INTERACTIVE, preinit_f);
     while (initial_win->shown()) {
         Fl::check();
         if (!SHOWING_LOADING_SCREEN_F) {
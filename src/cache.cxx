@@ -12,6 +12,12 @@
  */
 
 #include "../include/cache.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
 
 std::string CacheEntry::EMPTY_VALUE = "";
 
@@ -51,11 +57,26 @@ std::string CacheEntry::get(){
     return CacheEntry::EMPTY_VALUE;
 }
 
-time_t CacheEntry::get_expiration() {
+time_t CacheEntry::get_expiration() const {
     return this->creation_date + ttl;
 }
 
-void GeneralCache::init() {
+std::string format_cache_stats(const std::string& cache_name, const Cache_Stats& stats) {
+    char line[256];
+    unsigned long lookups = stats.hits + stats.misses;
+    snprintf(line, sizeof(line), "%s: %zu entries (%zu KB), %lu hits, %lu misses (hit ratio %.1f%%), %lu insertions, %lu evictions, %lu expirations.",
+             cache_name.c_str(), stats.entries, stats.bytes / 1024, stats.hits, stats.misses, (lookups > 0) ? 100.0 * stats.hits / lookups : 0.0,
+             stats.insertions, stats.evictions, stats.expirations);
+    std::string text(line);
+    if (stats.resolves > 0) {
+        snprintf(line, sizeof(line), " Average resolve time %.0f ms (%lu resolves), about %.1f s saved by the hits.",
+                 stats.average_resolve_ms, stats.resolves, stats.hits * stats.average_resolve_ms / 1000.0);
+        text += line;
+    }
+    return text;
+}
+
+void URLCache::init() {
     if (cache_entry_ttl < 120) {
         this->logger->warn(_("The time-to-live for a cache entry must not be less than 120 seconds. Setting to default value."));
         cache_entry_ttl = CacheEntry::DEFAULT_ENTRY_TTL;
@@ -64,15 +85,17 @@ void GeneralCache::init() {
     load();
 }
 
-CacheEntry* GeneralCache::search(std::string id) {
-    auto position = entries->find(id);
-    if (position != entries->end()) {
-        return position->second;
+void URLCache::insert(const std::string& id, CacheEntry&& entry) {
+    Cache_Shard& shard = shard_for(id);
+    size_t count_evicted;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        count_evicted = shard.insert(id, std::move(entry));
     }
-    return nullptr;
+    if (count_evicted > 0) logger->debug(std::to_string(count_evicted) + " cache entries evicted (least recently used), to keep the cache capacity.");
 }
 
-void GeneralCache::add_entry(std::string id, const std::string value) {
+void URLCache::add_entry(std::string id, const std::string value, time_t expiration) {
     // If the status is not "started", cancel adding the new entry.
     if (current_status != CACHE_RECORD_STATUS::STARTED) return;
 
@@ -85,88 +108,122 @@ void GeneralCache::add_entry(std::string id, const std::string value) {
         logger->warn(mssg);
         return;
     }
-    CacheEntry* ce = this->search(id);
-    if (ce != nullptr) {
-        if (!ce->is_valid() || ce->get() != sanit_value) {
-            // Delete old entry if is invalid or new value is different from saved.
-            if ( this->remove_entry(id) )
-                logger->debug(_("Cache entry DELETED - ID = ") + id);
-        } else {
-            // Otherwise, finalize the operation without adding or updating any cache entry...
+    unsigned int ttl = this->cache_entry_ttl;
+    if (expiration > 0) {
+        time_t now = time(0);
+        if (expiration <= now) {
+            logger->debug(_("Cache entry not created, because its value already expired. ID = ") + id);
             return;
         }
+        ttl = std::min<time_t>(ttl, expiration - now);
+    }
+    Cache_Shard& shard = shard_for(id);
+    size_t count_evicted;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        slot_node* node = find(shard, id);
+        // Finalize the operation without adding or updating any cache entry, if the same value is cached and valid...
+        if (node != nullptr && node->second.entry.is_valid() && node->second.entry.get() == sanit_value) return;
+        // Otherwise, add the new or updated cache entry (an old entry is replaced).
+        CacheEntry entry(sanit_value, ttl);
+        entry_added(id, entry);
+        count_evicted = shard.insert(id, std::move(entry));
     }
-    // Add the new or updated cache entry.
-    entries->insert(
-        std::make_pair(id, new CacheEntry(sanit_value, this->cache_entry_ttl))
-    );
     logger->debug(_("Creating a new cache entry for ID = ") + id);
+    if (count_evicted > 0) logger->debug(std::to_string(count_evicted) + " cache entries evicted (least recently used), to keep the cache capacity.");
 }
 
-bool GeneralCache::remove_entry(std::string id) {
-    auto position = entries->find(id);
-    if (position != entries->end()) {
-        CacheEntry* ce = position->second;
-        entries->erase(position);
-        delete ce;
-    }
-    // Returns true if the element was removed from map.
-    return (position != entries->end());
+bool URLCache::remove_entry(std::string id) {
+    Cache_Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    slot_node* node = find(shard, id);
+    if (node == nullptr) return false;
+    entry_removed(id);
+    shard.erase(node);
+    return true;
 }
 
-void GeneralCache::remove_all_entries() {
-    for (auto& pair : *entries) {
-        delete pair.second;
-    }
-    this->entries->clear();
+void URLCache::remove_all_entries() {
+    // Every shard is locked, so no entry is added between the clear and its notification.
+    std::vector<std::unique_lock<std::mutex>> locks = lock_all_shards();
+    for (Cache_Shard& shard: shards) shard.clear();
+    all_entries_removed();
 }
 
-std::string GeneralCache::get_entry_value(std::string id) {
-    CacheEntry* ce = this->search(id);
-    if (ce != nullptr && ce->is_valid()) {
-        // logger->debug("FOUND A VALUE CACHED FOR ID = " + id + ". THIS IS THE VALUE: " + ce->get());
-        return ce->get();
+Cache_Lookup URLCache::lookup(const std::string& id) {
+    return find_lookup(id, true);
+}
+
+Cache_Lookup URLCache::peek(const std::string& id) {
+    return find_lookup(id, false);
+}
+
+Cache_Lookup URLCache::find_lookup(const std::string& id, bool counted) {
+    Cache_Lookup result;
+    Cache_Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    slot_node* node = find_valid(shard, id, counted);
+    if (node != nullptr) {
+        result.found = true;
+        result.value = node->second.entry.get();
+        result.expiration = node->second.entry.get_expiration();
     }
-    return CacheEntry::EMPTY_VALUE;
+    return result;
 }
 
-GeneralCache::~GeneralCache() {
-    this->remove_all_entries();
+std::string URLCache::get_entry_value(std::string id) {
+    Cache_Lookup result = lookup(id);
+    return (result.found) ? result.value : CacheEntry::EMPTY_VALUE;
 }
 
-void GeneralCache::finish() {
+void URLCache::finish() {
     this->save();
 }
 
-bool GeneralCache::is_cached(std::string id) {
-    auto position = entries->find(id);
-    return ( position != entries->end() && position->second->is_valid());
+bool URLCache::is_cached(std::string id) {
+    Cache_Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return find_valid(shard, id, false) != nullptr;
+}
+
+std::string URLCache::format_expiration(time_t expiration) {
+    char time_buffer[128];
+    struct tm local_time;
+    // localtime() is not thread safe.
+    localtime_r(&expiration, &local_time);
+    std::strftime(time_buffer, sizeof(time_buffer), "%X", &local_time);
+    return time_buffer;
 }
 
-std::string GeneralCache::get_cache_expiration_date(std::string id) {
-    std::string result = "UNKNOWN";
-    CacheEntry* ce = search(id);
-    if (ce != nullptr) {
-        char time_buffer[128];
-        time_t t = ce->get_expiration();
-        std::strftime(time_buffer, sizeof(time_buffer), "%X", localtime(&t));
-        result = time_buffer;
+std::string URLCache::get_cache_expiration_date(std::string id) {
+    time_t expiration;
+    {
+        Cache_Shard& shard = shard_for(id);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        slot_node* node = find(shard, id);
+        // An invalid entry also has an expiration date...
+        if (node == nullptr) return "UNKNOWN";
+        expiration = node->second.entry.get_expiration();
     }
-    return result;
+    return format_expiration(expiration);
 }
 
-bool GeneralCache::change_status(CACHE_RECORD_STATUS new_status) {
-    if (this->current_status == new_status) return false;
-    this->current_status = new_status;
-    return true;
+size_t URLCache::cleanup() {
+    size_t count_removed = GeneralCache::cleanup();
+    if (count_removed > 0) logger->debug(std::to_string(count_removed) + " expired cache entries were removed.");
+    return count_removed;
 }
 
-int GeneralCache::load(){
+bool URLCache::change_status(CACHE_RECORD_STATUS new_status) {
+    return current_status.exchange(new_status) != new_status;
+}
+
+int URLCache::load(){
     logger->warn(_("This is a 'in memory' cache, so no load data function is available. Ignoring this call..."));
     return 0;
 }
 
-int GeneralCache::save() {
+int URLCache::save() {
     logger->warn(_("This is a 'in memory' cache, so no save function is available. Ignoring this call..."));
     return 0;
 }
@@ -205,81 +262,378 @@ void PermanentDiskCache::set_save_directory_path(std::string dirname_path, std::
     }
 }
 
-int PermanentDiskCache::load() {
-    char message_bffr[1024];
-    std::ifstream cache_file;
-    if (dirname.empty() || filename.empty()) {
-        logger->error(_("Aborting cache data load because no cache path was specified..."));
-        return 1;
+PermanentDiskCache::~PermanentDiskCache() {
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        if (journal != nullptr) fclose(journal);
     }
-    std::string cache_file_path = dirname + "/" + filename;
-    cache_file.open(cache_file_path, std::ofstream::in);
-    if ( ! cache_file.is_open()) {
-        snprintf(message_bffr, sizeof(message_bffr), _("No cache file found at %s. Proceeding without loading cache data..."), cache_file_path.c_str());
-        logger->warn(message_bffr);
-        return 1;
+    std::lock_guard<std::mutex> lock(mapping_mutex);
+    unmap_binary_snapshot();
+}
+
+bool PermanentDiskCache::open_journal() {
+    if (journal != nullptr) fclose(journal);
+    journal = fopen(journal_path().c_str(), "a");
+    if (journal == nullptr) {
+        logger->error(_("Cannot open the cache journal ") + journal_path() + ". " + _("Changes to the cache will only be saved at exit."));
+        return false;
+    }
+    return true;
+}
+
+void PermanentDiskCache::append_to_journal(const std::string& record) {
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    if (journal == nullptr) return;
+    // Flushed by record, so the change survives a crash of FLTube (but not of the system: the journal is not synced).
+    fputs(record.c_str(), journal);
+    fputc('\n', journal);
+    fflush(journal);
+    journal_records++;
+}
+
+void PermanentDiskCache::entry_added(const std::string& id, CacheEntry& entry) {
+    shadow(id);
+    append_to_journal(JOURNAL_ADD + id + FIELD_SEPARATOR + entry.get() + FIELD_SEPARATOR + std::to_string(entry.get_creation_date())
+                      + FIELD_SEPARATOR + std::to_string(entry.get_ttl()));
+}
+
+void PermanentDiskCache::entry_removed(const std::string& id) {
+    shadow(id);
+    append_to_journal(JOURNAL_REMOVE + id);
+}
+
+void PermanentDiskCache::all_entries_removed() {
+    {
+        std::lock_guard<std::mutex> lock(mapping_mutex);
+        unmap_binary_snapshot();
+    }
+    append_to_journal(std::string(1, JOURNAL_CLEAR));
+}
+
+void PermanentDiskCache::shadow(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mapping_mutex);
+    if (mapped_data != nullptr) shadowed_ids.insert(id);
+}
+
+long PermanentDiskCache::map_binary_snapshot(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat file_status;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &file_status) == 0 && (size_t) file_status.st_size >= sizeof(Binary_Header)) {
+        data = mmap(nullptr, file_status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping stays valid after closing the file (or replacing it with a new snapshot).
+    close(fd);
+    if (data == MAP_FAILED) {
+        logger->error(_("Cannot map the cache file ") + path);
+        return -1;
+    }
+    size_t size = file_status.st_size;
+    const Binary_Header* header = static_cast<const Binary_Header*>(data);
+    bool valid = memcmp(header->magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0 && header->version == BINARY_VERSION
+                 && header->index_offset % alignof(Binary_Index_Item) == 0 && header->index_offset <= size
+                 && header->entries_count <= (size - header->index_offset) / sizeof(Binary_Index_Item)
+                 && header->heap_offset <= size && header->heap_size <= size - header->heap_offset;
+    if (!valid) {
+        logger->error(_("The cache file is corrupted, or was saved by another FLTube version: ") + path);
+        munmap(data, size);
+        return -1;
     }
-    // If cache file exists and is open, proceed to read every line to populate initial cache.
+    std::lock_guard<std::mutex> lock(mapping_mutex);
+    unmap_binary_snapshot();
+    mapped_data = static_cast<const char*>(data);
+    mapped_size = size;
+    return header->entries_count;
+}
+
+void PermanentDiskCache::unmap_binary_snapshot() {
+    if (mapped_data != nullptr) munmap(const_cast<char*>(mapped_data), mapped_size);
+    mapped_data = nullptr;
+    mapped_size = 0;
+    shadowed_ids.clear();
+}
+
+std::string_view PermanentDiskCache::mapped_id(const Binary_Index_Item& item) {
+    const Binary_Header* header = reinterpret_cast<const Binary_Header*>(mapped_data);
+    if (item.id_offset > header->heap_size || item.id_size > header->heap_size - item.id_offset) return std::string_view();
+    return std::string_view(mapped_data + header->heap_offset + item.id_offset, item.id_size);
+}
+
+std::string_view PermanentDiskCache::mapped_value(const Binary_Index_Item& item) {
+    const Binary_Header* header = reinterpret_cast<const Binary_Header*>(mapped_data);
+    if (item.value_offset > header->heap_size || item.value_size > header->heap_size - item.value_offset) return std::string_view();
+    return std::string_view(mapped_data + header->heap_offset + item.value_offset, item.value_size);
+}
+
+const PermanentDiskCache::Binary_Index_Item* PermanentDiskCache::find_mapped(const std::string& id) {
+    if (mapped_data == nullptr) return nullptr;
+    const Binary_Header* header = reinterpret_cast<const Binary_Header*>(mapped_data);
+    const Binary_Index_Item* first = reinterpret_cast<const Binary_Index_Item*>(mapped_data + header->index_offset);
+    const Binary_Index_Item* last = first + header->entries_count;
+    const Binary_Index_Item* position = std::lower_bound(first, last, id, [this](const Binary_Index_Item& item, const std::string& key) {
+        return mapped_id(item) < key;
+    });
+    return (position != last && mapped_id(*position) == id) ? position : nullptr;
+}
+
+std::unique_ptr<CacheEntry> PermanentDiskCache::fetch_entry(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mapping_mutex);
+    if (mapped_data == nullptr || shadowed_ids.count(id) > 0) return nullptr;
+    const Binary_Index_Item* item = find_mapped(id);
+    if (item == nullptr) return nullptr;
+    // From now on, the entry lives in memory.
+    shadowed_ids.insert(id);
+    std::string_view value = mapped_value(*item);
+    if (value.empty() || item->creation_date + item->ttl < time(0)) return nullptr;
+    return std::make_unique<CacheEntry>(std::string(value), item->ttl, item->creation_date);
+}
+
+bool PermanentDiskCache::parse_entry(const std::string& line, std::string& id, std::string& value, unsigned long int& creation_date, int& ttl) {
+    std::vector<std::string> fields = tokenize(line, PermanentDiskCache::FIELD_SEPARATOR);
+    if (fields.size() != PermanentDiskCache::TOTAL_FIELDS_SAVED ) return false;
+    id = fields.at(FIELDS_POS::ID);
+    value = fields.at(FIELDS_POS::FINAL_URL);
+    trim(id); trim(value);
+    if (id.empty() || value.empty()) return false;
+    if (!isNumber(fields.at(FIELDS_POS::CREATION_DATE)) || !isNumber(fields.at(FIELDS_POS::TTL))) return false;
+    try {
+        creation_date = std::stoul(fields.at(FIELDS_POS::CREATION_DATE));
+        ttl = std::stoi(fields.at(FIELDS_POS::TTL));
+    } catch (const std::logic_error& e) {
+        return false;
+    }
+    return true;
+}
+
+int PermanentDiskCache::read_cache_file(const std::string& path, bool is_journal, int& count_rejected, int& count_not_valid) {
+    std::ifstream cache_file(path, std::ofstream::in);
+    if ( ! cache_file.is_open()) return -1;
     std::string line, id, final_url;
-    std::vector<std::string> fields;
-    int count_rejected = 0, count_not_valid = 0, total_count_lines = 0, ttl;
+    int ttl, total_count_lines = 0;
     unsigned long int creation_date_time;
+    time_t current_time = time(0);
     while (std::getline(cache_file, line)) {
+        // The last record of a journal could be partially written (i.e. FLTube was killed while appending it).
+        if (is_journal && cache_file.eof()) break;
         total_count_lines++;
         trim(line);
-        fields = tokenize(line, PermanentDiskCache::FIELD_SEPARATOR);
-        if (fields.size() != PermanentDiskCache::TOTAL_FIELDS_SAVED ) {
-            count_rejected++;
-            continue;
+        char operation = JOURNAL_ADD;
+        if (is_journal) {
+            if (line.empty()) {
+                count_rejected++;
+                continue;
+            }
+            operation = line.front();
+            line.erase(0, 1);
         }
-        id = fields.at(FIELDS_POS::ID);
-        final_url = fields.at(FIELDS_POS::FINAL_URL);
-        trim(id); trim(final_url);
-        if (id.empty() || final_url.empty() || is_cached(id)) {
-            count_rejected++;
+        if (operation == JOURNAL_CLEAR) {
+            {
+                std::lock_guard<std::mutex> lock(mapping_mutex);
+                unmap_binary_snapshot();
+            }
+            for (Cache_Shard& shard: shards) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                shard.clear();
+            }
             continue;
         }
-        if (!isNumber(fields.at(FIELDS_POS::CREATION_DATE)) || !isNumber(fields.at(FIELDS_POS::TTL))) {
-            count_rejected++;
+        if (operation == JOURNAL_REMOVE) {
+            trim(line);
+            shadow(line);
+            Cache_Shard& shard = shard_for(line);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto position = shard.entries.find(line);
+            if (position != shard.entries.end()) shard.erase(&(*position));
             continue;
         }
-        try {
-            creation_date_time = std::stoi(fields.at(FIELDS_POS::CREATION_DATE));
-            ttl = std::stoi(fields.at(FIELDS_POS::TTL));
-        } catch (const std::invalid_argument& e) {
+        // A snapshot has a single line by id, while the journal replaces entries.
+        if (operation != JOURNAL_ADD || !parse_entry(line, id, final_url, creation_date_time, ttl) || (!is_journal && is_cached(id))) {
             count_rejected++;
             continue;
         }
-        time_t current_time = time(0);
-        if (creation_date_time + ttl <current_time) {
+        if (is_journal) shadow(id);
+        if (creation_date_time + ttl < (unsigned long int) current_time) {
             // The cache entry become invalid due to expiration by date...
             count_not_valid++;
+            if (is_journal) remove_entry(id);
             continue;
         }
-        entries->insert(
-            std::make_pair(id, new CacheEntry(final_url, ttl, creation_date_time))
-        );
+        insert(id, CacheEntry(final_url, ttl, creation_date_time));
+    }
+    return total_count_lines;
+}
+
+int PermanentDiskCache::load() {
+    char message_bffr[1024];
+    if (dirname.empty() || filename.empty()) {
+        logger->error(_("Aborting cache data load because no cache path was specified..."));
+        return 1;
+    }
+    int count_rejected = 0, count_not_valid = 0, total_count_lines = 0;
+    // A binary snapshot is preferred (it is only saved when configured, and replaces the text one), whatever the format.
+    CACHE_FILE_FORMAT loaded_format = BINARY_FORMAT;
+    long mapped_entries = map_binary_snapshot(binary_snapshot_path());
+    int snapshot_lines = -1;
+    if (mapped_entries >= 0) {
+        logger->debug("Cache file " + binary_snapshot_path() + " mapped (" + std::to_string(mapped_entries) + " entries, fetched on demand).");
+    } else {
+        loaded_format = TEXT_FORMAT;
+        snapshot_lines = read_cache_file(snapshot_path(), false, count_rejected, count_not_valid);
     }
+    if (mapped_entries < 0 && snapshot_lines < 0) {
+        snprintf(message_bffr, sizeof(message_bffr), _("No cache file found at %s. Proceeding without loading cache data..."), snapshot_path().c_str());
+        logger->warn(message_bffr);
+    } else if (snapshot_lines > 0) {
+        total_count_lines += snapshot_lines;
+    }
+    // A journal rotated by an interrupted compaction is older than the current one.
+    int journal_lines = 0;
+    for (const std::string& path: { journal_path() + ".old", journal_path() }) {
+        int lines = read_cache_file(path, true, count_rejected, count_not_valid);
+        if (lines > 0) journal_lines += lines;
+    }
+    total_count_lines += journal_lines;
     snprintf(message_bffr, sizeof(message_bffr), _("Cache load statistics: ENTRIES_VALID=%d; ENTRIES_REJECTED=%d; ENTRIES_INVALID=%d; TOTAL_ENTRIES_PROCESSED=%d."), (total_count_lines - count_rejected - count_not_valid) ,count_rejected, count_not_valid, total_count_lines);
     logger->debug(message_bffr);
-    return 0;
+
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        open_journal();
+        journal_records = journal_lines;
+    }
+    bool found = mapped_entries >= 0 || snapshot_lines >= 0;
+    // Start from a single snapshot if the previous session didn't end by saving it, and convert a snapshot saved with
+    // the other format.
+    if (journal_lines > 0 || (found && loaded_format != file_format)) {
+        if (found && loaded_format != file_format) logger->info(_("Converting the cache file to the configured format..."));
+        compact_journal(true);
+    }
+    return found ? 0 : 1;
 }
 
-int PermanentDiskCache::save() {
-    if (validate_save_directory() && validate_save_filename()) {
-        std::ofstream outputfile;
-        //Open file (and create if not exists) for write.
-        outputfile.open(dirname + "/" + filename, std::ofstream::trunc);
-        for ( auto it = entries->begin(); it != entries->end(); it++ ) {
-            // saving every cache entry data as a line of the outputfile.
-            CacheEntry* ce = it->second;
-            if ( ! ce->is_valid() ) continue;
-            std::string ce_id = it->first;
-            outputfile << ce_id << FIELD_SEPARATOR << ce->get() << FIELD_SEPARATOR << ce->get_creation_date() << FIELD_SEPARATOR << ce->get_ttl() << "\n";
+std::vector<PermanentDiskCache::Saved_Entry> PermanentDiskCache::collect_entries() {
+    std::vector<Saved_Entry> saved_entries;
+    // Every shard is locked, so no entry is moved from the mapped snapshot to memory while they are copied.
+    std::vector<std::unique_lock<std::mutex>> locks = lock_all_shards();
+    time_t now = time(0);
+    {
+        // Entries never fetched from the mapped snapshot are the least recently used ones.
+        std::lock_guard<std::mutex> lock(mapping_mutex);
+        if (mapped_data != nullptr) {
+            const Binary_Header* header = reinterpret_cast<const Binary_Header*>(mapped_data);
+            const Binary_Index_Item* items = reinterpret_cast<const Binary_Index_Item*>(mapped_data + header->index_offset);
+            for (uint32_t i = 0; i < header->entries_count; i++) {
+                std::string_view id = mapped_id(items[i]), value = mapped_value(items[i]);
+                if (id.empty() || value.empty() || items[i].creation_date + items[i].ttl < now) continue;
+                std::string id_text(id);
+                if (shadowed_ids.count(id_text) > 0) continue;
+                saved_entries.push_back({ std::move(id_text), std::string(value), (time_t) items[i].creation_date, items[i].ttl });
+            }
+        }
+    }
+    for (Cache_Shard& shard: shards) {
+        // Saved from the least to the most recently used entry, so the LRU order (of every shard) is the same after loading the file.
+        for (slot_node* node = shard.least_recent; node != nullptr; node = node->second.newer) {
+            CacheEntry& ce = node->second.entry;
+            if ( ! ce.is_valid() ) continue;
+            saved_entries.push_back({ node->first, ce.get(), ce.get_creation_date(), ce.get_ttl() });
         }
-        outputfile.close();
-        logger->debug(_("All cache entries were saved at ") + dirname + "/" + filename);
-        return 0;
     }
-    return 1;
+    return saved_entries;
+}
+
+bool PermanentDiskCache::write_text_entries(FILE* output, const std::vector<Saved_Entry>& saved_entries) {
+    for (const Saved_Entry& saved: saved_entries) {
+        // saving every cache entry data as a line of the outputfile.
+        std::string line = saved.id + FIELD_SEPARATOR + saved.value + FIELD_SEPARATOR + std::to_string(saved.creation_date)
+                           + FIELD_SEPARATOR + std::to_string(saved.ttl) + "\n";
+        if (fputs(line.c_str(), output) < 0) return false;
+    }
+    return true;
+}
+
+bool PermanentDiskCache::write_binary_entries(FILE* output, const std::vector<Saved_Entry>& saved_entries) {
+    // The index is sorted by id (for the binary search at lookups), while the heap keeps the LRU order.
+    std::vector<Binary_Index_Item> index;
+    index.reserve(saved_entries.size());
+    uint64_t heap_size = 0;
+    for (const Saved_Entry& saved: saved_entries) {
+        Binary_Index_Item item = {};
+        item.id_offset = heap_size;
+        item.id_size = saved.id.size();
+        item.value_offset = heap_size + saved.id.size();
+        item.value_size = saved.value.size();
+        item.creation_date = saved.creation_date;
+        item.ttl = saved.ttl;
+        heap_size += saved.id.size() + saved.value.size();
+        index.push_back(item);
+    }
+    std::vector<size_t> order(saved_entries.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::sort(order.begin(), order.end(), [&saved_entries](size_t a, size_t b) {
+        return saved_entries[a].id < saved_entries[b].id;
+    });
+
+    Binary_Header header = {};
+    memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.version = BINARY_VERSION;
+    header.entries_count = saved_entries.size();
+    header.index_offset = sizeof(Binary_Header);
+    header.heap_offset = header.index_offset + index.size() * sizeof(Binary_Index_Item);
+    header.heap_size = heap_size;
+    if (fwrite(&header, sizeof(header), 1, output) != 1) return false;
+    for (size_t position: order) {
+        if (fwrite(&index[position], sizeof(Binary_Index_Item), 1, output) != 1) return false;
+    }
+    for (const Saved_Entry& saved: saved_entries) {
+        if (fwrite(saved.id.data(), 1, saved.id.size(), output) != saved.id.size()) return false;
+        if (fwrite(saved.value.data(), 1, saved.value.size(), output) != saved.value.size()) return false;
+    }
+    return true;
+}
+
+bool PermanentDiskCache::write_snapshot() {
+    std::string path = saved_snapshot_path();
+    std::vector<Saved_Entry> saved_entries = collect_entries();
+    bool written = write_file_atomically(path, [this, &saved_entries](FILE* outputfile) {
+        return (file_format == BINARY_FORMAT) ? write_binary_entries(outputfile, saved_entries) : write_text_entries(outputfile, saved_entries);
+    });
+    if (!written) {
+        logger->error(_("Cannot write the cache file ") + path);
+        return false;
+    }
+    // A snapshot of the other format is outdated now (a mapped one remains readable until it is unmapped).
+    std::error_code ignored;
+    std::filesystem::remove((file_format == BINARY_FORMAT) ? snapshot_path() : binary_snapshot_path(), ignored);
+    return true;
+}
+
+int PermanentDiskCache::compact_journal(bool force) {
+    std::lock_guard<std::mutex> compaction_lock(compaction_mutex);
+    std::string old_journal_path = journal_path() + ".old";
+    {
+        std::lock_guard<std::mutex> lock(journal_mutex);
+        if (!force && journal_records < JOURNAL_COMPACTION_RECORDS) return 0;
+        if (!validate_save_directory() || !validate_save_filename()) return 1;
+        // Changes made while the snapshot is written go to a new journal. The rotated one is only needed until the
+        // snapshot is renamed (and replayed before the new journal, if FLTube ends before that).
+        // If a rotated journal remains (the previous snapshot failed), the current one is kept to not overwrite it.
+        if (journal != nullptr && !std::filesystem::exists(old_journal_path)) {
+            fclose(journal);
+            journal = nullptr;
+            rename(journal_path().c_str(), old_journal_path.c_str());
+        }
+        if (journal == nullptr) open_journal();
+        journal_records = 0;
+    }
+    if (!write_snapshot()) return 1;
+    remove(old_journal_path.c_str());
+    logger->debug(_("All cache entries were saved at ") + saved_snapshot_path());
+    return 0;
+}
+
+int PermanentDiskCache::save() {
+    cleanup();
+    return compact_journal(true);
 }
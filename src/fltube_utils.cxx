@@ -12,6 +12,7 @@
  */
 
 #include "../include/fltube_utils.h"
+#include "../include/thumbnail_decoder.h"
 #include <string>
 
 /** Mapping FS_PERMISSION_NAMES to corresponding std::filesystem::perms. */
@@ -24,52 +25,45 @@ static const std::map<SIMPLE_FS_PERMISSION, std::map<std::string, std::filesyste
         {{"OWNER", std::filesystem::perms::owner_exec}, {"GROUP", std::filesystem::perms::group_exec}, {"OTHERS", std::filesystem::perms::others_exec}}},
 };
 
-/**
- * Execute a system command and returns its output.
- * Also, the variable @exitStatus keep the exit status code for the command execution. If command's pipe
- * cannot be closed, then @exitStatus holds a -1 value.
- */
-std::string exec(const char* cmd, int& exitStatus) {
-    std::array<char, 4 * 1024> buffer;  // Buffer for reading up to 4096 characters per fgets() call.
-    std::string result;
-    result.reserve(8 * 1024);           // Pre-allocates 8KB to reduce reallocations as result grows.
-
-    int pclose_status;
-    auto deleter = [&pclose_status](FILE* p) {
-        if (p) { pclose_status = pclose(p); }
-    };
-
-    std::unique_ptr<FILE, decltype(deleter)> pipe(popen(cmd, "r"), deleter);
-
-    if (!pipe) {
-        printf(_("There was an error executing the following command: %s \n"), cmd);
-        printf(_("Closing the program due to an error.\n"));
-        exit(2);
-    }
-
-    while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-        result.append(buffer.data());
-    }
+void Cancellation_Token::cancel() {
+    std::lock_guard<std::mutex> lock(token_mutex);
+    cancelled.store(true);
+    for (const auto& [pid, signal_number]: attached_pids) kill(pid, signal_number);
+}
 
-    // Close pipe and get exit status of executed command.
-    pipe.reset();
-    exitStatus = -1;
-    if (pclose_status != -1) {
-        if (WIFEXITED(pclose_status)) {
-            exitStatus = WEXITSTATUS(pclose_status);
-        }
-    }
+bool Cancellation_Token::attach(pid_t pid, int signal_number) {
+    std::lock_guard<std::mutex> lock(token_mutex);
+    if (cancelled.load()) return false;
+    attached_pids[pid] = signal_number;
+    return true;
+}
 
-    return result;
+void Cancellation_Token::detach(pid_t pid) {
+    std::lock_guard<std::mutex> lock(token_mutex);
+    attached_pids.erase(pid);
 }
 
 /**
- * Execute a system command and returns its output. Use this overload function
- * if you don't care to ignore the command's exit status.
+ * Quote an argument to be safely passed to /bin/sh as a single word, in example: it's -> 'it'\''s'.
  */
-std::string exec(const char* cmd) {
-    int exitStatus = -10;
-    return exec(cmd, exitStatus);
+std::string shell_quote(const std::string& arg) {
+    std::string quoted = "'";
+    for (char c: arg) {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    quoted += "'";
+    return quoted;
+}
+
+/** Returns every argument quoted with @shell_quote(), separated by a space. */
+std::string join_shell_args(const std::vector<std::string>& args) {
+    std::string joined;
+    for (const std::string& arg: args) {
+        if (!joined.empty()) joined += " ";
+        joined += shell_quote(arg);
+    }
+    return joined;
 }
 
 /** Attempts to make a SIMPLE check if a text is an URL. */
@@ -173,6 +167,36 @@ bool canWriteOnDir(const char* directory){
     return checkDirectoryPermissions(directory, {CAN_WRITE});
 }
 
+/**
+ *  Write a file through a temporary one ("<path>.tmp"), filled by @write_content (false on error), synced to disk and
+ *  renamed over @path, so @path is never found partially written, even after a system crash (rename is atomic, but not
+ *  the data). Returns false on error, removing the temporary file.
+ */
+bool write_file_atomically(const std::string& path, const std::function<bool(FILE*)>& write_content) {
+    std::string temporal_path = path + ".tmp";
+    FILE* file = fopen(temporal_path.c_str(), "wb");
+    if (file == nullptr) return false;
+    bool written = write_content(file) && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = (fclose(file) == 0) && written;
+    if (!written || rename(temporal_path.c_str(), path.c_str()) != 0) {
+        remove(temporal_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool write_file_atomically(const std::string& path, const std::string& content) {
+    return write_file_atomically(path, [&content](FILE* file) {
+        return fwrite(content.data(), 1, content.size(), file) == content.size();
+    });
+}
+
+/** Initialize libcurl once. Stream URLs are checked from background threads, and curl_global_init() is not thread safe. */
+void init_curl() {
+    static std::once_flag curl_initialized;
+    std::call_once(curl_initialized, []() { curl_global_init(CURL_GLOBAL_ALL); });
+}
+
 /**
  *  Create a CURL handle, for an specific URL (not null) and an optional output_file;
  */
@@ -181,7 +205,7 @@ static CURL* get_curl_handle(const char* forURL, FILE* output_file) {
         return nullptr;
     }
     CURL *curl;
-    curl_global_init(CURL_GLOBAL_ALL);
+    init_curl();
     curl = curl_easy_init();
     if (curl) {
         curl_easy_setopt(curl, CURLOPT_URL, forURL);
@@ -193,6 +217,25 @@ static CURL* get_curl_handle(const char* forURL, FILE* output_file) {
     return curl;
 }
 
+/** CURLOPT_WRITEFUNCTION that appends the received data to a std::string. */
+static size_t write_to_buffer(char* data, size_t size, size_t count, void* output_buffer) {
+    static_cast<std::string*>(output_buffer)->append(data, size * count);
+    return size * count;
+}
+
+/**
+ *  Create a CURL handle, for an specific URL (not null), that appends the received data to @output_buffer (i.e. to decode
+ *  it without writing a file first).
+ */
+CURL* get_curl_handle(const char* forURL, std::string& output_buffer) {
+    CURL* curl = get_curl_handle(forURL);
+    if (curl) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_to_buffer);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &output_buffer);
+    }
+    return curl;
+}
+
 //Function for download a file to a local output directory, and set a custom name. Returns 0 if all is ok.
 FLTUBE_STATUS_CODES download_file(std::string url, std::string output_dir, std::string outfilename, bool overwrite) {
     CURL *curl;
@@ -256,6 +299,7 @@ FLTUBE_STATUS_CODES check_url_access(std::string url) {
                 }
             }
         }
+        curl_easy_cleanup(curl);
     }
     return returnCode;
 }
@@ -293,18 +337,8 @@ Fl_Image* create_resized_image_from_jpg(std::string jpg_filepath, int target_wid
     if(!std::filesystem::exists(jpg_filepath)) {
         return nullptr;
     }
-    Fl_Image* original_image = new Fl_JPEG_Image(jpg_filepath.c_str());
-
-    /*** Resize method --> https://es.elitescreens.eu/pages/screen-size-calculator ***/
-    // (h / w) * target_width
-    int new_height = ceil((original_image->h() / static_cast<double>(original_image->w())) * target_width);
-
-    Fl_Image* resized_image = original_image->copy(target_width, new_height);
-
-    //Free unused memory.
-    delete original_image;
-
-    return  resized_image;
+    // Decoded near the target width when possible, and reduced averaging the pixels (see thumbnail_decoder.h).
+    return decode_resized_jpeg(jpg_filepath, target_width);
 }
 
 /*
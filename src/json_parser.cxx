@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/json_parser.h"
+#include <cstdio>
+
+/* Append the UTF-8 representation of a unicode code point to @output. */
+static void append_utf8(std::string& output, unsigned long code_point) {
+    if (code_point < 0x80) {
+        output.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+        output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+        output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else {
+        output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+        output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    }
+}
+
+/* Parse 4 hexadecimal digits. Returns false if any of them is not a valid hex digit. */
+static bool parse_hex4(std::string_view digits, unsigned long& value) {
+    if (digits.size() < 4) return false;
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = digits[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9')       value |= (c - '0');
+        else if (c >= 'a' && c <= 'f')  value |= (c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F')  value |= (c - 'A' + 10);
+        else return false;
+    }
+    return true;
+}
+
+bool JsonSaxParser::parse(std::string_view json_text, JsonSaxHandler& h) {
+    text = json_text;
+    pos = 0;
+    depth = 0;
+    handler = &h;
+    skip_whitespaces();
+    if (!parse_value()) return false;
+    skip_whitespaces();
+    // Nothing but whitespaces are allowed after the document...
+    return pos == text.size();
+}
+
+void JsonSaxParser::skip_whitespaces() {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) pos++;
+}
+
+bool JsonSaxParser::parse_value() {
+    if (pos >= text.size()) return false;
+    std::string_view value;
+    switch (text[pos]) {
+        case '{':   return parse_object();
+        case '[':   return parse_array();
+        case '"':
+            if (!parse_string(value)) return false;
+            handler->on_string(value);
+            return true;
+        case 't':
+            if (!parse_literal("true")) return false;
+            handler->on_bool(true);
+            return true;
+        case 'f':
+            if (!parse_literal("false")) return false;
+            handler->on_bool(false);
+            return true;
+        case 'n':
+            if (!parse_literal("null")) return false;
+            handler->on_null();
+            return true;
+        default:
+            return parse_number();
+    }
+}
+
+bool JsonSaxParser::parse_object() {
+    if (++depth > MAX_DEPTH) return false;
+    pos++;  // Skip '{'
+    handler->on_start_object();
+    skip_whitespaces();
+    if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        depth--;
+        handler->on_end_object();
+        return true;
+    }
+    std::string_view key;
+    while (pos < text.size()) {
+        if (text[pos] != '"' || !parse_string(key)) return false;
+        handler->on_key(key);
+        skip_whitespaces();
+        if (pos >= text.size() || text[pos] != ':') return false;
+        pos++;
+        skip_whitespaces();
+        if (!parse_value()) return false;
+        skip_whitespaces();
+        if (pos >= text.size()) return false;
+        if (text[pos] == ',') {
+            pos++;
+            skip_whitespaces();
+        } else if (text[pos] == '}') {
+            pos++;
+            depth--;
+            handler->on_end_object();
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool JsonSaxParser::parse_array() {
+    if (++depth > MAX_DEPTH) return false;
+    pos++;  // Skip '['
+    handler->on_start_array();
+    skip_whitespaces();
+    if (pos < text.size() && text[pos] == ']') {
+        pos++;
+        depth--;
+        handler->on_end_array();
+        return true;
+    }
+    while (pos < text.size()) {
+        if (!parse_value()) return false;
+        skip_whitespaces();
+        if (pos >= text.size()) return false;
+        if (text[pos] == ',') {
+            pos++;
+            skip_whitespaces();
+        } else if (text[pos] == ']') {
+            pos++;
+            depth--;
+            handler->on_end_array();
+            return true;
+        } else {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool JsonSaxParser::parse_string(std::string_view& value) {
+    size_t start = ++pos;   // Skip opening quote
+    bool has_escapes = false;
+    while (pos < text.size() && text[pos] != '"') {
+        if (text[pos] == '\\') {
+            has_escapes = true;
+            pos++;
+        }
+        pos++;
+    }
+    if (pos >= text.size()) return false;
+    std::string_view raw = text.substr(start, pos - start);
+    pos++;  // Skip closing quote
+    if (!has_escapes) {
+        value = raw;
+        return true;
+    }
+    if (!unescape(raw)) return false;
+    value = unescaped_buffer;
+    return true;
+}
+
+bool JsonSaxParser::unescape(std::string_view raw) {
+    unescaped_buffer.clear();
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (raw[i] != '\\') {
+            unescaped_buffer.push_back(raw[i]);
+            continue;
+        }
+        if (++i >= raw.size()) return false;
+        switch (raw[i]) {
+            case '"':   unescaped_buffer.push_back('"'); break;
+            case '\\':  unescaped_buffer.push_back('\\'); break;
+            case '/':   unescaped_buffer.push_back('/'); break;
+            case 'b':   unescaped_buffer.push_back('\b'); break;
+            case 'f':   unescaped_buffer.push_back('\f'); break;
+            case 'n':   unescaped_buffer.push_back('\n'); break;
+            case 'r':   unescaped_buffer.push_back('\r'); break;
+            case 't':   unescaped_buffer.push_back('\t'); break;
+            case 'u': {
+                unsigned long code_point;
+                if (!parse_hex4(raw.substr(i + 1), code_point)) return false;
+                i += 4;
+                // Characters outside the BMP are written as a surrogate pair (i.e. emojis at video titles).
+                if (code_point >= 0xD800 && code_point <= 0xDBFF && i + 6 < raw.size() &&raw[i + 1] == '\\' && raw[i + 2] == 'u') {
+                    unsigned long low_surrogate;
+                    if (parse_hex4(raw.substr(i + 3), low_surrogate) && low_surrogate >= 0xDC00 && low_surrogate <= 0xDFFF) {
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                        i += 6;
+                    }
+                }
+                append_utf8(unescaped_buffer, code_point);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+bool JsonSaxParser::parse_number() {
+    size_t start = pos;
+    if (pos < text.size() && text[pos] == '-') pos++;
+    size_t digits_start = pos;
+    while (pos < text.size() && ((text[pos] >= '0' && text[pos] <= '9') || text[pos] == '.' || text[pos] == 'e'
+                                 || text[pos] == 'E' || text[pos] == '+' || text[pos] == '-')) pos++;
+    if (pos == digits_start) return false;
+    handler->on_number(text.substr(start, pos - start));
+    return true;
+}
+
+bool JsonSaxParser::parse_literal(std::string_view literal) {
+    if (text.compare(pos, literal.size(), literal) != 0) return false;
+    pos += literal.size();
+    return true;
+}
+
+std::string json_string(std::string_view value) {
+    std::string quoted;
+    quoted.reserve(value.size() + 2);
+    quoted.push_back('"');
+    for (char c: value) {
+        switch (c) {
+            case '"':   quoted += "\\\""; break;
+            case '\\':  quoted += "\\\\"; break;
+            case '\n':  quoted += "\\n"; break;
+            case '\r':  quoted += "\\r"; break;
+            case '\t':  quoted += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+                    quoted += escaped;
+                } else {
+                    quoted.push_back(c);
+                }
+        }
+    }
+    quoted.push_back('"');
+    return quoted;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/process_manager.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+
+extern char **environ;
+
+/* Milliseconds between two checks of the supervised processes, when no output is received. */
+static const int SUPERVISE_INTERVAL_MS = 100;
+
+pid_t ProcessManager::spawn(const std::vector<std::string>& argv, pid_t pgid, int stdin_fd, int stdout_fd, const Process_Options& options, int& spawn_error) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (stdin_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+    } else {
+        // A process at a background process group reading the terminal would be stopped with SIGTTIN...
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    }
+    if (stdout_fd >= 0) posix_spawn_file_actions_adddup2(&actions, stdout_fd, STDOUT_FILENO);
+    if (!options.stderr_path.empty()) {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, options.stderr_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setpgroup(&attributes, pgid);
+    // FLTube ignores SIGPIPE, but a producer of a pipeline must die if its consumer (i.e. the player) is closed.
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<char*> c_argv;
+    for (const std::string& arg: argv) c_argv.push_back(const_cast<char*>(arg.c_str()));
+    c_argv.push_back(nullptr);
+
+    pid_t pid = -1;
+    spawn_error = argv.empty() ? EINVAL : posix_spawnp(&pid, c_argv[0], &actions, &attributes, c_argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (spawn_error != 0) {
+        logger->error(_("Cannot execute the following command: ") + join_shell_args(argv) + " (" + std::string(strerror(spawn_error)) + ")");
+        return -1;
+    }
+    logger->debug("EXEC COMMAND = " + join_shell_args(argv) + " (PID " + std::to_string(pid) + ")");
+    return pid;
+}
+
+std::vector<Process_Result> ProcessManager::supervise(const std::vector<std::vector<std::string>>& commands, const std::vector<pid_t>& pids,
+                                                      pid_t pgid, int output_fd, const process_line_handler& on_line, const Process_Options& options) {
+    using clock = std::chrono::steady_clock;
+    std::vector<Process_Result> results(pids.size());
+    std::vector<bool> running(pids.size(), true);
+    size_t running_count = pids.size();
+    clock::time_point start = clock::now();
+    clock::time_point deadline = start + std::chrono::milliseconds(options.timeout_ms);
+    clock::time_point kill_time;
+    bool terminating = false, killed = false, timed_out = false;
+
+    auto terminate = [&](clock::time_point now) {
+        if (terminating) return;
+        kill(-pgid, SIGTERM);
+        terminating = true;
+        kill_time = now + std::chrono::milliseconds(TERMINATE_GRACE_MS);
+    };
+
+    if (options.token != nullptr && !options.token->attach(-pgid, SIGTERM)) {
+        // Cancelled before the processes were started...
+        terminate(clock::now());
+    }
+
+    std::array<char, 4 * 1024> buffer;
+    std::string pending;
+    bool output_open = (output_fd >= 0);
+    // Without output to read, nor timeout nor token to check, simply block until the processes end.
+    bool blocking_wait = !output_open && options.timeout_ms == 0 && options.token == nullptr;
+
+    while (running_count > 0) {
+        clock::time_point now = clock::now();
+        if (options.timeout_ms > 0 && !timed_out && now >= deadline) {
+            timed_out = true;
+            logger->warn(_("The following command exceeded its time limit and will be terminated: ") + join_shell_args(commands.back()));
+            terminate(now);
+        }
+        if (options.token != nullptr && options.token->is_cancelled() && !terminating) {
+            // The token already sent a SIGTERM to the process group.
+            terminating = true;
+            kill_time = now + std::chrono::milliseconds(TERMINATE_GRACE_MS);
+        }
+        if (terminating && !killed && now >= kill_time) {
+            kill(-pgid, SIGKILL);
+            killed = true;
+        }
+
+        if (output_open) {
+            struct pollfd pfd = { output_fd, POLLIN, 0 };
+            if (poll(&pfd, 1, SUPERVISE_INTERVAL_MS) > 0) {
+                ssize_t count = read(output_fd, buffer.data(), buffer.size());
+                if (count > 0) {
+                    pending.append(buffer.data(), count);
+                    size_t line_start = 0, eol;
+                    while ((eol = pending.find('\n', line_start)) != std::string::npos) {
+                        on_line(pending.substr(line_start, eol - line_start));
+                        line_start = eol + 1;
+                    }
+                    pending.erase(0, line_start);
+                } else if (count == 0 || errno != EINTR) {
+                    output_open = false;
+                }
+            }
+        } else if (!blocking_wait) {
+            poll(nullptr, 0, SUPERVISE_INTERVAL_MS);
+        }
+
+        for (size_t i = 0; i < pids.size(); i++) {
+            if (!running[i]) continue;
+            int status;
+            struct rusage usage;
+            pid_t waited = wait4(pids[i], &status, blocking_wait ? 0 : WNOHANG, &usage);
+            if (waited == 0 || (waited < 0 && errno == EINTR)) continue;
+            running[i] = false;
+            running_count--;
+            Process_Result& result = results[i];
+            result.spawned = true;
+            if (waited == pids[i]) {
+                if (WIFEXITED(status))      result.exit_status = WEXITSTATUS(status);
+                if (WIFSIGNALED(status))    result.term_signal = WTERMSIG(status);
+                result.user_cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0;
+                result.system_cpu_seconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+                result.max_rss_kb = usage.ru_maxrss;
+            }
+            result.wall_seconds = std::chrono::duration<double>(clock::now() - start).count();
+        }
+    }
+
+    // Read the output that remains at the pipe, but don't wait for children that keep it opened after the processes ended.
+    while (output_open) {
+        struct pollfd pfd = { output_fd, POLLIN, 0 };
+        ssize_t count = (poll(&pfd, 1, 0) > 0) ? read(output_fd, buffer.data(), buffer.size()) : 0;
+        if (count <= 0) break;
+        pending.append(buffer.data(), count);
+    }
+    size_t line_start = 0, eol;
+    while ((eol = pending.find('\n', line_start)) != std::string::npos) {
+        on_line(pending.substr(line_start, eol - line_start));
+        line_start = eol + 1;
+    }
+    if (line_start < pending.size()) on_line(pending.substr(line_start));
+
+    bool cancelled = false;
+    if (options.token != nullptr) {
+        options.token->detach(-pgid);
+        cancelled = options.token->is_cancelled();
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        results[i].timed_out = timed_out;
+        results[i].cancelled = cancelled;
+        log_result(commands[i], pids[i], results[i]);
+    }
+    return results;
+}
+
+void ProcessManager::log_result(const std::vector<std::string>& argv, pid_t pid, const Process_Result& result) {
+    char usage_text[256];
+    snprintf(usage_text, sizeof(usage_text), "wall %.2fs, user CPU %.2fs, system CPU %.2fs, max RSS %ld KB",
+             result.wall_seconds, result.user_cpu_seconds, result.system_cpu_seconds, result.max_rss_kb);
+    std::string end_reason;
+    if (result.timed_out)           end_reason = "timed out, ";
+    else if (result.cancelled)      end_reason = "cancelled, ";
+    if (result.term_signal != 0)    end_reason += "killed by signal " + std::to_string(result.term_signal);
+    else                            end_reason += "exit status " + std::to_string(result.exit_status);
+    logger->debug("Process '" + (argv.empty() ? std::string("") : argv[0]) + "' (PID " + std::to_string(pid) + ") ended: "
+                  + end_reason + ". Usage: " + usage_text + ".");
+}
+
+Process_Result ProcessManager::run(const std::vector<std::string>& argv, const process_line_handler& on_line, const Process_Options& options) {
+    Process_Result result;
+    int out_pipe[2] = { -1, -1 };
+    if (options.capture_output && pipe2(out_pipe, O_CLOEXEC) != 0) {
+        result.spawn_error = errno;
+        logger->error(_("Cannot create a pipe to read the output of: ") + join_shell_args(argv));
+        return result;
+    }
+    pid_t pid = spawn(argv, 0, -1, out_pipe[1], options, result.spawn_error);
+    if (out_pipe[1] >= 0) close(out_pipe[1]);
+    if (pid < 0) {
+        if (out_pipe[0] >= 0) close(out_pipe[0]);
+        return result;
+    }
+    result = supervise({ argv }, { pid }, pid, out_pipe[0], on_line, options).front();
+    if (out_pipe[0] >= 0) close(out_pipe[0]);
+    return result;
+}
+
+std::string ProcessManager::run(const std::vector<std::string>& argv, Process_Result& result, const Process_Options& options) {
+    std::string output;
+    output.reserve(8 * 1024);
+    result = run(argv, [&output](const std::string& line) {
+        output.append(line);
+        output.push_back('\n');
+    }, options);
+    return output;
+}
+
+Process_Result ProcessManager::run_pipeline(const std::vector<std::string>& producer, const std::vector<std::string>& consumer, const Process_Options& options) {
+    Process_Result result;
+    int data_pipe[2];
+    if (pipe2(data_pipe, O_CLOEXEC) != 0) {
+        result.spawn_error = errno;
+        logger->error(_("Cannot create a pipe to run the following command: ") + join_shell_args(producer));
+        return result;
+    }
+    Process_Options pipeline_options = options;
+    pipeline_options.capture_output = false;
+    pid_t producer_pid = spawn(producer, 0, -1, data_pipe[1], pipeline_options, result.spawn_error);
+    close(data_pipe[1]);
+    if (producer_pid < 0) {
+        close(data_pipe[0]);
+        return result;
+    }
+    // Both processes share the producer process group, so they are terminated together.
+    pid_t consumer_pid = spawn(consumer, producer_pid, data_pipe[0], -1, pipeline_options, result.spawn_error);
+    close(data_pipe[0]);
+    if (consumer_pid < 0) {
+        kill(-producer_pid, SIGTERM);
+        supervise({ producer }, { producer_pid }, producer_pid, -1, nullptr, pipeline_options);
+        return result;
+    }
+    return supervise({ producer, consumer }, { producer_pid, consumer_pid }, producer_pid, -1, nullptr, pipeline_options).back();
+}
+
+std::vector<std::string> ProcessManager::split_args(const std::string& command_line) {
+    std::vector<std::string> args;
+    std::string current;
+    bool in_arg = false;
+    char quote = '\0';
+    for (char c: command_line) {
+        if (quote != '\0') {
+            if (c == quote) quote = '\0';
+            else current.push_back(c);
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            in_arg = true;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (in_arg) args.push_back(current);
+            current.clear();
+            in_arg = false;
+        } else {
+            current.push_back(c);
+            in_arg = true;
+        }
+    }
+    if (in_arg) args.push_back(current);
+    return args;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+
+static const char* LANE_NAMES[TASK_LANES_COUNT] = { "interactive", "speculative", "housekeeping" };
+
+static double elapsed_ms(std::chrono::steady_clock::time_point since, std::chrono::steady_clock::time_point until) {
+    return std::chrono::duration<double, std::milli>(until - since).count();
+}
+
+unsigned int ThreadPool::default_size() {
+    return std::max(4u, std::thread::hardware_concurrency() + 2);
+}
+
+ThreadPool::ThreadPool(std::shared_ptr<TerminalLogger> const& lgg, unsigned int workers): state(std::make_shared<Shared_State>()), logger(lgg) {
+    workers_count = std::max(2u, (workers == 0) ? default_size() : workers);
+    // Background lanes use at most half of the CPUs, and never every worker.
+    unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+    state->background_limit = std::max(1u, std::min(cpus / 2, workers_count - 1));
+    for (unsigned int i = 0; i < workers_count; i++) {
+        // Workers only own the shared state, so they can outlive the pool (see ~ThreadPool).
+        std::thread worker(&ThreadPool::worker_loop, state);
+        worker.detach();
+    }
+    logger->debug("Thread pool started with " + std::to_string(workers_count) + " workers (" + std::to_string(state->background_limit)
+                  + " for background lanes).");
+}
+
+ThreadPool::~ThreadPool() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->stopping = true;
+    for (Lane_State& lane: state->lanes) lane.queue.clear();
+    state->task_available.notify_all();
+}
+
+bool ThreadPool::submit(TASK_LANE lane, pool_task task) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    Lane_State& lane_state = state->lanes[lane];
+    if (state->stopping || (MAX_QUEUED_TASKS[lane] > 0 && lane_state.queue.size() >= MAX_QUEUED_TASKS[lane])) {
+        lane_state.rejected++;
+        return false;
+    }
+    lane_state.queue.push_back({ std::move(task), std::chrono::steady_clock::now() });
+    lane_state.submitted++;
+    state->task_available.notify_one();
+    return true;
+}
+
+bool ThreadPool::next_task(Shared_State& state, Queued_Task& task, int& lane) {
+    for (int i = 0; i < TASK_LANES_COUNT; i++) {
+        if (state.lanes[i].queue.empty()) continue;
+        if (i != LANE_INTERACTIVE && state.background_running >= state.background_limit) return false;
+        task = std::move(state.lanes[i].queue.front());
+        state.lanes[i].queue.pop_front();
+        lane = i;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(std::shared_ptr<Shared_State> state) {
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        Queued_Task queued;
+        int lane;
+        state->task_available.wait(lock, [&]() {
+            return state->stopping || next_task(*state, queued, lane);
+        });
+        if (state->stopping) return;
+
+        auto start_time = std::chrono::steady_clock::now();
+        Lane_State& lane_state = state->lanes[lane];
+        double wait_ms = elapsed_ms(queued.submit_time, start_time);
+        lane_state.total_wait_ms += wait_ms;
+        lane_state.max_wait_ms = std::max(lane_state.max_wait_ms, wait_ms);
+        lane_state.running++;
+        if (lane != LANE_INTERACTIVE) state->background_running++;
+        lock.unlock();
+
+        queued.task();
+        queued.task = nullptr;
+
+        lock.lock();
+        lane_state.running--;
+        lane_state.completed++;
+        lane_state.total_run_ms += elapsed_ms(start_time, std::chrono::steady_clock::now());
+        if (lane != LANE_INTERACTIVE) {
+            state->background_running--;
+            // A background task could be waiting for this background slot.
+            state->task_available.notify_one();
+        }
+    }
+}
+
+Lane_Stats ThreadPool::get_stats(TASK_LANE lane) {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    const Lane_State& lane_state = state->lanes[lane];
+    Lane_Stats stats;
+    stats.queued = lane_state.queue.size();
+    stats.running = lane_state.running;
+    stats.submitted = lane_state.submitted;
+    stats.completed = lane_state.completed;
+    stats.rejected = lane_state.rejected;
+    unsigned long started = lane_state.submitted - stats.queued;
+    if (started > 0) stats.average_wait_ms = lane_state.total_wait_ms / started;
+    if (stats.completed > 0) stats.average_run_ms = lane_state.total_run_ms / stats.completed;
+    stats.max_wait_ms = lane_state.max_wait_ms;
+    return stats;
+}
+
+void ThreadPool::log_stats() {
+    char line[256];
+    for (int i = 0; i < TASK_LANES_COUNT; i++) {
+        Lane_Stats stats = get_stats(static_cast<TASK_LANE>(i));
+        snprintf(line, sizeof(line), "Thread pool lane '%s': %lu submitted, %lu completed, %lu rejected, %zu queued, %zu running. "
+                 "Wait avg %.1f ms (max %.1f ms), run avg %.1f ms.", LANE_NAMES[i], stats.submitted, stats.completed, stats.rejected,
+                 stats.queued, stats.running, stats.average_wait_ms, stats.max_wait_ms, stats.average_run_ms);
+        logger->debug(line);
+    }
+}
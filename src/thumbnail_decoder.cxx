@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/thumbnail_decoder.h"
+#include <FL/Fl_JPEG_Image.H>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#ifdef FLTUBE_FAST_JPEG_DECODE
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+/* Weights are fixed point numbers, so a weight fits at 16 bits and a weighted sum of 8 bits values at 32 bits. */
+static const int WEIGHT_BITS = 14;
+static const uint32_t WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+/* The source pixels averaged into every target pixel, along one axis. */
+struct Resize_Taps {
+    /* First source pixel of every target pixel. */
+    std::vector<int> first;
+    /* Position of the weights of every target pixel at @weights (and the end of the last one). */
+    std::vector<size_t> offset;
+    std::vector<uint16_t> weights;
+};
+
+/* Every target pixel covers @source_size / @target_size source pixels: a source pixel weights the part of it covered. */
+static Resize_Taps compute_taps(int source_size, int target_size) {
+    Resize_Taps taps;
+    double scale = static_cast<double>(source_size) / target_size;
+    taps.offset.push_back(0);
+    for (int i = 0; i < target_size; i++) {
+        double start = i * scale;
+        double end = std::min<double>(source_size, (i + 1) * scale);
+        int first = std::min(source_size - 1, static_cast<int>(start));
+        int last = std::max(first + 1, std::min(source_size, static_cast<int>(std::ceil(end))));
+        size_t largest = taps.weights.size();
+        uint32_t sum = 0;
+        for (int k = first; k < last; k++) {
+            double covered = std::min<double>(end, k + 1) - std::max<double>(start, k);
+            uint16_t weight = static_cast<uint16_t>(std::max(0.0, covered / scale) * WEIGHT_ONE + 0.5);
+            if (k == first || weight > taps.weights[largest]) largest = taps.weights.size();
+            taps.weights.push_back(weight);
+            sum += weight;
+        }
+        // Rounding errors go to the largest weight, so the weights of a pixel always sum one.
+        taps.weights[largest] += WEIGHT_ONE - sum;
+        taps.first.push_back(first);
+        taps.offset.push_back(taps.weights.size());
+    }
+    return taps;
+}
+
+/* @sums[i] += @row[i] * @weight, for @count bytes. */
+static void accumulate_row(uint32_t* sums, const unsigned char* row, int count, uint16_t weight) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_set1_epi16(static_cast<short>(weight));
+    for (; i + 16 <= count; i += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        // Products of two 16 bits values: their low and high halves are interleaved to get the 32 bits products.
+        __m128i low_lo = _mm_mullo_epi16(low, weights);
+        __m128i low_hi = _mm_mulhi_epu16(low, weights);
+        __m128i high_lo = _mm_mullo_epi16(high, weights);
+        __m128i high_hi = _mm_mulhi_epu16(high, weights);
+        __m128i* target = reinterpret_cast<__m128i*>(sums + i);
+        _mm_storeu_si128(target, _mm_add_epi32(_mm_loadu_si128(target), _mm_unpacklo_epi16(low_lo, low_hi)));
+        _mm_storeu_si128(target + 1, _mm_add_epi32(_mm_loadu_si128(target + 1), _mm_unpackhi_epi16(low_lo, low_hi)));
+        _mm_storeu_si128(target + 2, _mm_add_epi32(_mm_loadu_si128(target + 2), _mm_unpacklo_epi16(high_lo, high_hi)));
+        _mm_storeu_si128(target + 3, _mm_add_epi32(_mm_loadu_si128(target + 3), _mm_unpackhi_epi16(high_lo, high_hi)));
+    }
+#elif defined(__ARM_NEON)
+    const uint16x4_t weights = vdup_n_u16(weight);
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t pixels = vld1q_u8(row + i);
+        uint16x8_t low = vmovl_u8(vget_low_u8(pixels));
+        uint16x8_t high = vmovl_u8(vget_high_u8(pixels));
+        vst1q_u32(sums + i, vmlal_u16(vld1q_u32(sums + i), vget_low_u16(low), weights));
+        vst1q_u32(sums + i + 4, vmlal_u16(vld1q_u32(sums + i + 4), vget_high_u16(low), weights));
+        vst1q_u32(sums + i + 8, vmlal_u16(vld1q_u32(sums + i + 8), vget_low_u16(high), weights));
+        vst1q_u32(sums + i + 12, vmlal_u16(vld1q_u32(sums + i + 12), vget_high_u16(high), weights));
+    }
+#endif
+    for (; i < count; i++) sums[i] += row[i] * static_cast<uint32_t>(weight);
+}
+
+/* @row[i] = @sums[i] / WEIGHT_ONE (rounded), for @count bytes. The sums never exceed 255 * WEIGHT_ONE. */
+static void store_row(unsigned char* row, const uint32_t* sums, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128i half = _mm_set1_epi32(WEIGHT_ONE / 2);
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* source = reinterpret_cast<const __m128i*>(sums + i);
+        __m128i a = _mm_srli_epi32(_mm_add_epi32(_mm_loadu_si128(source), half), WEIGHT_BITS);
+        __m128i b = _mm_srli_epi32(_mm_add_epi32(_mm_loadu_si128(source + 1), half), WEIGHT_BITS);
+        __m128i c = _mm_srli_epi32(_mm_add_epi32(_mm_loadu_si128(source + 2), half), WEIGHT_BITS);
+        __m128i d = _mm_srli_epi32(_mm_add_epi32(_mm_loadu_si128(source + 3), half), WEIGHT_BITS);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), packed);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint16x8_t low = vcombine_u16(vrshrn_n_u32(vld1q_u32(sums + i), WEIGHT_BITS), vrshrn_n_u32(vld1q_u32(sums + i + 4), WEIGHT_BITS));
+        uint16x8_t high = vcombine_u16(vrshrn_n_u32(vld1q_u32(sums + i + 8), WEIGHT_BITS), vrshrn_n_u32(vld1q_u32(sums + i + 12), WEIGHT_BITS));
+        vst1q_u8(row + i, vcombine_u8(vqmovn_u16(low), vqmovn_u16(high)));
+    }
+#endif
+    for (; i < count; i++) row[i] = static_cast<unsigned char>(std::min<uint32_t>(255, (sums[i] + WEIGHT_ONE / 2) >> WEIGHT_BITS));
+}
+
+void resize_area_average(const unsigned char* source, int source_w, int source_h, int source_ld, int depth,
+                         unsigned char* target, int target_w, int target_h) {
+    int row_bytes = source_w * depth;
+    if (source_ld == 0) source_ld = row_bytes;
+
+    // Rows: every target row is the weighted sum of the source rows it covers.
+    Resize_Taps row_taps = compute_taps(source_h, target_h);
+    std::vector<unsigned char> reduced(static_cast<size_t>(row_bytes) * target_h);
+    std::vector<uint32_t> sums(row_bytes);
+    for (int y = 0; y < target_h; y++) {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (size_t k = row_taps.offset[y]; k < row_taps.offset[y + 1]; k++) {
+            int source_y = row_taps.first[y] + static_cast<int>(k - row_taps.offset[y]);
+            accumulate_row(sums.data(), source + static_cast<size_t>(source_y) * source_ld, row_bytes, row_taps.weights[k]);
+        }
+        store_row(reduced.data() + static_cast<size_t>(y) * row_bytes, sums.data(), row_bytes);
+    }
+
+    // Columns, at the reduced rows.
+    Resize_Taps column_taps = compute_taps(source_w, target_w);
+    for (int y = 0; y < target_h; y++) {
+        const unsigned char* row = reduced.data() + static_cast<size_t>(y) * row_bytes;
+        unsigned char* target_row = target + static_cast<size_t>(y) * target_w * depth;
+        for (int x = 0; x < target_w; x++) {
+            for (int channel = 0; channel < depth; channel++) {
+                uint32_t sum = 0;
+                const unsigned char* pixel = row + column_taps.first[x] * depth + channel;
+                for (size_t k = column_taps.offset[x]; k < column_taps.offset[x + 1]; k++, pixel += depth) {
+                    sum += *pixel * static_cast<uint32_t>(column_taps.weights[k]);
+                }
+                target_row[x * depth + channel] = static_cast<unsigned char>(std::min<uint32_t>(255, (sum + WEIGHT_ONE / 2) >> WEIGHT_BITS));
+            }
+        }
+    }
+}
+
+/* Returns a new image with @source resized to @target_width, keeping its aspect ratio. */
+static Fl_RGB_Image* resize_pixels(const unsigned char* source, int width, int height, int ld, int depth, int target_width) {
+    int target_height = std::max(1, static_cast<int>(ceil((height / static_cast<double>(width)) * target_width)));
+    if (target_width >= width || target_height >= height) {
+        // Not a reduction: there is no area to average.
+        Fl_RGB_Image original(source, width, height, depth, ld);
+        return static_cast<Fl_RGB_Image*>(original.copy(target_width, target_height));
+    }
+    unsigned char* pixels = new unsigned char[static_cast<size_t>(target_width) * target_height * depth];
+    resize_area_average(source, width, height, ld, depth, pixels, target_width, target_height);
+    Fl_RGB_Image* resized = new Fl_RGB_Image(pixels, target_width, target_height, depth);
+    resized->alloc_array = 1;
+    return resized;
+}
+
+#ifdef FLTUBE_FAST_JPEG_DECODE
+/* libjpeg error manager that returns to decode_scaled_jpeg() instead of exiting. */
+struct Jpeg_Error_Manager {
+    jpeg_error_mgr manager;
+    jmp_buf return_point;
+};
+
+static void jpeg_error_exit(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<Jpeg_Error_Manager*>(cinfo->err)->return_point, 1);
+}
+
+static void jpeg_ignore_message(j_common_ptr cinfo) {}
+
+/* Decode a JPEG image with libjpeg, at the smallest scale not narrower than @target_width. The image is read from @file,
+ * or from the @size bytes at @data if @file is nullptr. Returns false if it cannot be decoded (i.e. a CMYK image, that
+ * FLTK can decode). */
+static bool decode_scaled_jpeg(FILE* file, const unsigned char* data, size_t size, int target_width, std::vector<unsigned char>& pixels,
+                               int& width, int& height, int& depth) {
+    jpeg_decompress_struct cinfo;
+    Jpeg_Error_Manager error_manager;
+    cinfo.err = jpeg_std_error(&error_manager.manager);
+    error_manager.manager.error_exit = jpeg_error_exit;
+    error_manager.manager.output_message = jpeg_ignore_message;
+    if (setjmp(error_manager.return_point)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    if (file != nullptr) jpeg_stdio_src(&cinfo, file);
+    else jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data), size);
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.jpeg_color_space == JCS_GRAYSCALE) cinfo.out_color_space = JCS_GRAYSCALE;
+    else if (cinfo.jpeg_color_space == JCS_YCbCr || cinfo.jpeg_color_space == JCS_RGB) cinfo.out_color_space = JCS_RGB;
+    else longjmp(error_manager.return_point, 1);
+    // libjpeg without support for N/8 scales uses the nearest supported scale that is not smaller.
+    cinfo.scale_denom = 8;
+    cinfo.scale_num = 8;
+    while (cinfo.scale_num > 1 && (cinfo.image_width * (cinfo.scale_num - 1) + 7) / 8 >= static_cast<unsigned int>(target_width)) {
+        cinfo.scale_num--;
+    }
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    depth = cinfo.output_components;
+    size_t row_bytes = static_cast<size_t>(width) * depth;
+    pixels.resize(row_bytes * height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = pixels.data() + cinfo.output_scanline * row_bytes;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+#endif
+
+Fl_RGB_Image* decode_resized_jpeg(const std::string& jpg_filepath, int target_width) {
+    if (target_width <= 0) return nullptr;
+#ifdef FLTUBE_FAST_JPEG_DECODE
+    FILE* file = fopen(jpg_filepath.c_str(), "rb");
+    if (file != nullptr) {
+        std::vector<unsigned char> pixels;
+        int width, height, depth;
+        bool decoded = decode_scaled_jpeg(file, nullptr, 0, target_width, pixels, width, height, depth);
+        fclose(file);
+        if (decoded) return resize_pixels(pixels.data(), width, height, 0, depth, target_width);
+    }
+#endif
+    Fl_JPEG_Image original(jpg_filepath.c_str());
+    if (original.w() <= 0 || original.h() <= 0 || original.d() <= 0 || original.array == nullptr) return nullptr;
+    return resize_pixels(original.array, original.w(), original.h(), original.ld(), original.d(), target_width);
+}
+
+Fl_RGB_Image* decode_resized_jpeg(const unsigned char* data, size_t size, int target_width) {
+    // FLTK reads a JPEG at memory without knowing its size: only complete images (from SOI to EOI markers) are decoded.
+    if (target_width <= 0 || size < 4 || data[0] != 0xFF || data[1] != 0xD8 || data[size - 2] != 0xFF || data[size - 1] != 0xD9) {
+        return nullptr;
+    }
+#ifdef FLTUBE_FAST_JPEG_DECODE
+    std::vector<unsigned char> pixels;
+    int width, height, depth;
+    if (decode_scaled_jpeg(nullptr, data, size, target_width, pixels, width, height, depth)) {
+        return resize_pixels(pixels.data(), width, height, 0, depth, target_width);
+    }
+#endif
+    Fl_JPEG_Image original("thumbnail", data);
+    if (original.w() <= 0 || original.h() <= 0 || original.d() <= 0 || original.array == nullptr) return nullptr;
+    return resize_pixels(original.array, original.w(), original.h(), original.ld(), original.d(), target_width);
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/thumbnail_loader.h"
+#include <algorithm>
+#include <map>
+
+/* Maximum milliseconds the loader thread waits for network activity before checking for new requests. */
+static const int POLL_INTERVAL_MS = 1000;
+
+ThumbnailLoader::ThumbnailLoader(std::shared_ptr<TerminalLogger> const& lgg, unsigned int connections):
+    logger(lgg), max_connections((connections > 0) ? connections : 1) {
+    init_curl();
+    loader = std::thread(&ThumbnailLoader::loader_loop, this);
+}
+
+ThumbnailLoader::~ThumbnailLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        if (multi != nullptr) curl_multi_wakeup(multi);
+        requests_available.notify_all();
+    }
+    loader.join();
+}
+
+unsigned long ThumbnailLoader::load(std::vector<Thumbnail_Request> requests, thumbnail_done_handler on_done) {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    pending = std::move(requests);
+    pending_handler = std::move(on_done);
+    if (multi != nullptr) curl_multi_wakeup(multi);
+    requests_available.notify_all();
+    return generation;
+}
+
+CURL* ThumbnailLoader::create_transfer(Transfer& transfer) {
+    transfer.result.data = std::make_shared<std::string>();
+    const Thumbnail_Request& request = transfer.result.request;
+    CURL* curl = get_curl_handle(request.url.c_str(), *transfer.result.data);
+    if (curl == nullptr) return nullptr;
+    if (!request.etag.empty()) transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + request.etag).c_str());
+    if (!request.last_modified.empty()) {
+        transfer.headers = curl_slist_append(transfer.headers, ("If-Modified-Since: " + request.last_modified).c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, CONNECT_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, DOWNLOAD_TIMEOUT);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, read_header);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer.result);
+    transfer.start_time = std::chrono::steady_clock::now();
+    return curl;
+}
+
+size_t ThumbnailLoader::read_header(char* buffer, size_t size, size_t count, void* result) {
+    size_t length = size * count;
+    std::string header(buffer, length);
+    size_t separator = header.find(':');
+    if (separator == std::string::npos) return length;
+    std::string name = header.substr(0, separator);
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    std::string value = header.substr(separator + 1);
+    trim(value);
+    Thumbnail_Result* thumbnail_result = static_cast<Thumbnail_Result*>(result);
+    if (name == "etag") thumbnail_result->etag = value;
+    else if (name == "last-modified") thumbnail_result->last_modified = value;
+    return length;
+}
+
+void ThumbnailLoader::finish_transfer(Transfer& transfer, bool succeeded) {
+    if (transfer.headers != nullptr) {
+        curl_slist_free_all(transfer.headers);
+        transfer.headers = nullptr;
+    }
+    Thumbnail_Result& result = transfer.result;
+    result.downloaded = succeeded && (result.not_modified || !result.data->empty());
+    result.bytes = result.data->size();
+    result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - transfer.start_time).count();
+}
+
+void ThumbnailLoader::loader_loop() {
+    CURLM* multi_handle = curl_multi_init();
+    curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(max_connections));
+    // Transfers by their easy handle. They are allocated once, so the header callback can keep a pointer to their result.
+    std::map<CURL*, std::unique_ptr<Transfer>> transfers;
+    unsigned long running_generation = 0;
+    thumbnail_done_handler handler;
+
+    auto cancel_all = [&]() {
+        for (auto& [curl, transfer]: transfers) {
+            curl_multi_remove_handle(multi_handle, curl);
+            curl_easy_cleanup(curl);
+            finish_transfer(*transfer, false);
+        }
+        transfers.clear();
+    };
+
+    std::unique_lock<std::mutex> lock(mutex);
+    multi = multi_handle;
+    while (!stopping) {
+        if (generation != running_generation) {
+            // A new page is shown: the downloads for the previous one are not useful anymore.
+            if (!transfers.empty()) logger->debug(std::to_string(transfers.size()) + " thumbnail downloads cancelled by a newer page.");
+            cancel_all();
+            running_generation = generation;
+            handler = pending_handler;
+            for (const Thumbnail_Request& request: pending) {
+                std::unique_ptr<Transfer> transfer = std::make_unique<Transfer>();
+                transfer->result.request = request;
+                transfer->result.generation = running_generation;
+                CURL* curl = create_transfer(*transfer);
+                if (curl == nullptr) continue;
+                transfers.emplace(curl, std::move(transfer));
+                curl_multi_add_handle(multi_handle, curl);
+            }
+            pending.clear();
+        }
+        if (transfers.empty()) {
+            requests_available.wait(lock, [this, running_generation]() { return stopping || generation != running_generation; });
+            continue;
+        }
+        lock.unlock();
+
+        int still_running = 0;
+        curl_multi_perform(multi_handle, &still_running);
+        std::vector<Thumbnail_Result> finished;
+        int queued_messages;
+        CURLMsg* message;
+        while ((message = curl_multi_info_read(multi_handle, &queued_messages)) != nullptr) {
+            if (message->msg != CURLMSG_DONE) continue;
+            CURL* curl = message->easy_handle;
+            CURLcode code = message->data.result;
+            long response_code = 0;
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+            auto position = transfers.find(curl);
+            curl_multi_remove_handle(multi_handle, curl);
+            curl_easy_cleanup(curl);
+            if (position == transfers.end()) continue;
+            Transfer& transfer = *position->second;
+            transfer.result.not_modified = (code == CURLE_OK && response_code == 304);
+            finish_transfer(transfer, code == CURLE_OK);
+            if (code != CURLE_OK) {
+                logger->debug("Thumbnail download failed (" + std::string(curl_easy_strerror(code)) + "): " + transfer.result.request.url);
+            }
+            finished.push_back(transfer.result);
+            transfers.erase(position);
+        }
+        for (const Thumbnail_Result& result: finished) handler(result);
+        if (!transfers.empty()) curl_multi_poll(multi_handle, nullptr, 0, POLL_INTERVAL_MS, nullptr);
+
+        lock.lock();
+    }
+    multi = nullptr;
+    lock.unlock();
+    cancel_all();
+    curl_multi_cleanup(multi_handle);
+}
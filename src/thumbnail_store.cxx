@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/thumbnail_store.h"
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <unordered_set>
+
+const std::string ThumbnailStore::INDEX_FILENAME = "index.txt";
+const std::string ThumbnailStore::INDEX_HEADER = "FLTUBE_THUMBNAILS\t1";
+
+/* Count of fields of an index line: validated date, bytes, file name, ETag, Last-Modified and URL. */
+static const size_t INDEX_FIELDS_COUNT = 6;
+
+void Thumbnail_Store_Policy::evicted(const std::string& url, Thumbnail_File& file) {
+    std::error_code error;
+    std::filesystem::remove(file.path, error);
+}
+
+ThumbnailStore::ThumbnailStore(std::shared_ptr<TerminalLogger> const& lgg): GeneralCache(1), logger(lgg) {}
+
+bool ThumbnailStore::open(const std::string& dirname_path, size_t max_bytes) {
+    std::error_code error;
+    std::filesystem::create_directories(dirname_path, error);
+    if (!std::filesystem::is_directory(dirname_path, error) || !canWriteOnDir(dirname_path.c_str())) {
+        logger->warn(_("Cannot use the thumbnails cache directory: ") + dirname_path);
+        return false;
+    }
+    directory = dirname_path;
+    if (directory.back() != '/') directory += "/";
+    index_path = directory + INDEX_FILENAME;
+    clear();
+    set_capacity(0, max_bytes);
+    int count_loaded = load_index();
+    remove_orphan_files();
+    Cache_Stats stats = get_stats();
+    logger->debug("Thumbnails cache at " + directory + ": " + std::to_string(count_loaded) + " thumbnails loaded ("
+                  + std::to_string(stats.bytes / 1024) + " KB).");
+    return true;
+}
+
+/* Split an index line at its tabs (empty fields are kept). */
+static std::vector<std::string> split_index_line(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return fields;
+}
+
+int ThumbnailStore::load_index() {
+    std::ifstream index(index_path);
+    std::string line;
+    if (!index.is_open() || !getline(index, line) || line != INDEX_HEADER) return 0;
+    int count_loaded = 0;
+    // Lines are ordered from the least to the most recently used, so the LRU order of the previous session is kept.
+    while (getline(index, line)) {
+        std::vector<std::string> fields = split_index_line(line);
+        if (fields.size() != INDEX_FIELDS_COUNT || fields[2].empty() || fields[2].find('/') != std::string::npos) continue;
+        Thumbnail_File file;
+        file.path = path_for(fields[2]);
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(file.path, error);
+        if (error || size == 0) continue;
+        file.bytes = size;
+        file.validated = strtoll(fields[0].c_str(), nullptr, 10);
+        file.etag = fields[3];
+        file.last_modified = fields[4];
+        put(fields[5], file);
+        count_loaded++;
+    }
+    return count_loaded;
+}
+
+void ThumbnailStore::remove_orphan_files() {
+    std::unordered_set<std::string> stored_paths;
+    {
+        auto locks = lock_all_shards();
+        for (Cache_Shard& shard: shards) {
+            for (const slot_node& node: shard.entries) stored_paths.insert(node.second.entry.path);
+        }
+    }
+    std::error_code error;
+    for (const auto& item: std::filesystem::directory_iterator(directory, error)) {
+        std::string filename = item.path().filename().string();
+        // Thumbnails, and the temporary files of the thumbnails not written completely ("th_<id>.jpg.tmp").
+        bool thumbnail_file = (filename.rfind("th_", 0) == 0);
+        if (!item.is_regular_file(error) || !thumbnail_file || stored_paths.count(item.path().string()) > 0) continue;
+        std::filesystem::remove(item.path(), error);
+    }
+}
+
+int ThumbnailStore::save() {
+    if (index_path.empty()) return FLT_GENERAL_FAILED;
+    std::string content = INDEX_HEADER + "\n";
+    {
+        auto locks = lock_all_shards();
+        for (Cache_Shard& shard: shards) {
+            for (slot_node* node = shard.least_recent; node != nullptr; node = node->second.newer) {
+                const Thumbnail_File& file = node->second.entry;
+                content += std::to_string(file.validated) + "\t" + std::to_string(file.bytes) + "\t"
+                    + std::filesystem::path(file.path).filename().string() + "\t" + file.etag + "\t" + file.last_modified + "\t"
+                    + node->first + "\n";
+            }
+        }
+    }
+    if (!write_file_atomically(index_path, content)) {
+        logger->warn(_("Cannot save the thumbnails cache index at: ") + index_path);
+        return FLT_GENERAL_FAILED;
+    }
+    return FLT_OK;
+}
+
+bool ThumbnailStore::lookup(const std::string& url, Thumbnail_File& file) {
+    if (!get(url, file)) return false;
+    if (std::filesystem::exists(file.path)) return true;
+    // Removed by someone else: download it again.
+    remove(url);
+    return false;
+}
+
+void ThumbnailStore::store(const std::string& url, Thumbnail_File file) {
+    if (file.validated == 0) file.validated = time(0);
+    put(url, std::move(file));
+}
+
+bool ThumbnailStore::save_thumbnail(const std::string& url, Thumbnail_File file, const std::string& data) {
+    // Written atomically, so a partial thumbnail is never read.
+    if (!write_file_atomically(file.path, data)) {
+        logger->warn(_("Cannot create the thumbnail file: ") + file.path);
+        return false;
+    }
+    file.bytes = data.size();
+    store(url, std::move(file));
+    return true;
+}
+
+void ThumbnailStore::revalidated(const std::string& url) {
+    Cache_Shard& shard = shard_for(url);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    slot_node* node = shard.search(url);
+    if (node != nullptr) node->second.entry.validated = time(0);
+}
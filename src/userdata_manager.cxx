@@ -20,6 +20,13 @@ std::string UserDataManager::WATCHLATER_LIST_NAME = "Watch Later";
 std::string UserDataManager::VIDEOS_TXT_SEPARATOR = "===VIDEOS===";
 std::string UserDataManager::LISTS_TXT_SEPARATOR = "===LISTS===";
 
+Video* YTDLP_Video_Metadata::to_video() const {
+    auto text = [](long long number) {
+        return (number == METADATA_UNKNOWN_NUMBER) ? std::string("NA") : std::to_string(number);
+    };
+    return new Video(id, title, creators, channel_id, text(viewers_count), text(duration), thumbnail_url);
+}
+
 UserDataManager::UserDataManager(std::string userdata_filepath, int current_version, std::shared_ptr<TerminalLogger> const& logger_)
     : userdata_filepath(userdata_filepath), userdatafile_software_version(current_version),
         videos(std::make_unique<std::map<std::string, Video*>>()),
@@ -14,15 +14,203 @@
 #include "../include/ytdlp_helper.h"
 #include <cstdio>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <future>
 
 const std::string YtDlp_Helper::DEFAULT_YTDLP_PATH = "yt-dlp";
 
 const std::string YtDlp_Helper::ALTERN_YT_PLAYER_CLIENT = "web_embedded";
+const std::string YtDlp_Helper::STREAM_URLS_PRINT_TEMPLATE = "%(original_url)s\t%(requested_formats.0.url,url)s\t%(requested_formats.1.url|)s";
+const std::string YtDlp_Helper::PERSISTED_SEARCH_HEADER = "FLTUBE_SEARCH_CACHE\t1";
 
-/** Parse the metadata printed by the exec of a yt-dlp command. Returns a YTDLP_Video_Metadata struct. */
-YTDLP_Video_Metadata* YtDlp_Helper::parse_metadata(const char ytdlp_video_metadata[1024]){
-    std::stringstream lineStream(ytdlp_video_metadata);
-    YTDLP_Video_Metadata* metadata = new YTDLP_Video_Metadata();
+/* Milliseconds elapsed since @start_time. */
+static double elapsed_ms(std::chrono::steady_clock::time_point start_time) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+/**
+ * Fills a YTDLP_Video_Metadata with the events of a JSON object printed by a JSON metadata template. Only the fields
+ * at the first level of the object are used; JSON nulls are saved as "NA", as yt-dlp prints them at the text templates.
+ */
+class Metadata_Json_Handler : public JsonSaxHandler {
+private:
+    YTDLP_Video_Metadata* metadata;
+    unsigned int depth = 0;
+    std::string current_key;
+    bool reading_tags = false;
+
+public:
+    Metadata_Json_Handler(YTDLP_Video_Metadata* m): metadata(m) {};
+
+    void on_start_object() override {
+        depth++;
+    }
+
+    void on_end_object() override {
+        depth--;
+    }
+
+    void on_start_array() override {
+        depth++;
+        reading_tags = (depth == 2 && current_key == "tags");
+    }
+
+    void on_end_array() override {
+        depth--;
+        reading_tags = false;
+    }
+
+    void on_key(std::string_view key) override {
+        if (depth == 1) current_key.assign(key);
+    }
+
+    void on_string(std::string_view value) override {
+        if (reading_tags) {
+            metadata->tags.emplace_back(value);
+        } else if (depth == 1) {
+            YtDlp_Helper::set_metadata_field(metadata, current_key, value);
+        }
+    }
+
+    void on_number(std::string_view raw_number) override {
+        if (depth == 1) YtDlp_Helper::set_metadata_field(metadata, current_key, raw_number);
+    }
+
+    void on_bool(bool value) override {
+        if (depth == 1) YtDlp_Helper::set_metadata_field(metadata, current_key, value ? "true" : "false");
+    }
+
+    void on_null() override {
+        if (depth == 1 && current_key != "tags") YtDlp_Helper::set_metadata_field(metadata, current_key, "NA");
+    }
+};
+
+void YtDlp_Helper::set_metadata_field(YTDLP_Video_Metadata* metadata, std::string_view key, std::string_view value) {
+    if (key == "title") {
+        metadata->title = value;
+    } else if (key == "video_id"){
+        metadata->id = value;
+    } else if (key == "creators"){
+        metadata->creators = value;
+    } else if (key == "upload_date"){
+        metadata->upload_date = value;
+    } else if (key == "duration"){
+        metadata->duration = parse_duration(value);
+    } else if (key == "thumbnail"){
+        metadata->thumbnail_url = value;
+    } else if (key == "channel_id"){
+        metadata->channel_id = value;
+    } else if (key == "live_status"){
+        if (value == "is_live")             metadata->live_status = YT_LIVE_STATUS::IS_LIVE;
+        else if (value == "not_live")       metadata->live_status = YT_LIVE_STATUS::NOT_LIVE;
+        else if (value == "is_upcoming")    metadata->live_status = YT_LIVE_STATUS::IS_UPCOMING;
+        else if (value == "was_live")       metadata->live_status = YT_LIVE_STATUS::WAS_LIVE;
+        else if (value == "post_live")      metadata->live_status = YT_LIVE_STATUS::POST_LIVE;
+        else metadata->live_status = YT_LIVE_STATUS::LIVE_STATUS_UNKNOWN;
+    } else if (key == "is_live"){
+        std::string lw_val(value);
+        std::transform(lw_val.begin(), lw_val.end(), lw_val.begin(), ::tolower);    //lowercase
+        metadata->is_live = (lw_val == "true") ? true : false;
+    } else if (key == "viewers_count"){
+        metadata->viewers_count = parse_metadata_number(value);
+    } else if (key == "concurrent_viewers_count"){
+        metadata->concurrent_viewers_count = parse_metadata_number(value);
+    } else if (key == "followers"){
+        metadata->channel_follower_count = parse_metadata_number(value);
+    } else if (key == "like_count"){
+        metadata->like_count = parse_metadata_number(value);
+    }  else if (key == "timestamp"){
+        metadata->timestamp = parse_metadata_number(value);
+    }  else if (key == "timestamp_text"){
+        metadata->timestamp_text = value;
+    }  else if (key == "media_type"){
+        if (value == "video")   metadata->media_type = YT_VIDEO_TYPE::VIDEO;
+        else if (value == "short")    metadata->media_type = YT_VIDEO_TYPE::SHORT;
+        else if (value == "livestream")    metadata->media_type = YT_VIDEO_TYPE::LIVESTREAM;
+        else metadata->media_type = YT_VIDEO_TYPE::UNKNONW;
+    }  else if (key == "category"){
+        metadata->category = value;
+    }   else if (key == "description"){
+        metadata->description = value;
+    }   else if (key == "tags"){
+        if (value != "") metadata->tags = tokenize(std::string(value), ',');
+    }
+}
+
+long long YtDlp_Helper::parse_metadata_number(std::string_view value) {
+    long long number;
+    auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc() || end == value.data()) return METADATA_UNKNOWN_NUMBER;
+    return number;
+}
+
+long long YtDlp_Helper::parse_duration(std::string_view value) {
+    // "HH:MM:SS" was written at the saved video lists by some versions...
+    long long seconds = 0;
+    size_t field_start = 0;
+    do {
+        size_t field_end = value.find(':', field_start);
+        long long field = parse_metadata_number(value.substr(field_start, field_end - field_start));
+        if (field < 0) return METADATA_UNKNOWN_NUMBER;
+        seconds = seconds * 60 + field;
+        field_start = (field_end == std::string_view::npos) ? field_end : field_end + 1;
+    } while (field_start != std::string_view::npos);
+    return seconds;
+}
+
+std::string YTDLP_Video_Metadata::duration_text() const {
+    if (duration < 0) return "NA";
+    char text[32];
+    snprintf(text, sizeof(text), "%02lld:%02lld:%02lld", duration / 3600, (duration / 60) % 60, duration % 60);
+    return std::string(text);
+}
+
+size_t YTDLP_Video_Metadata::footprint() const {
+    auto heap_size = [](const std::string& str) -> size_t {
+        // Short strings are stored inside the std::string object itself (SSO).
+        return (str.capacity() > 15) ? str.capacity() + 1 : 0;
+    };
+    size_t total = sizeof(YTDLP_Video_Metadata) + heap_size(id) + heap_size(title) + heap_size(url) + heap_size(upload_date)
+        + heap_size(creators) + heap_size(channel_id) + heap_size(thumbnail_url) + heap_size(description)
+        + heap_size(timestamp_text) + heap_size(category) + tags.capacity() * sizeof(std::string);
+    for (const std::string& tag: tags) total += heap_size(tag);
+    return total;
+}
+
+void Search_Results::reserve_batch(size_t count) {
+    if (count == 0 || block_capacity - block_used >= count) return;
+    blocks.push_back(std::make_unique<YTDLP_Video_Metadata[]>(count));
+    block_capacity = count;
+    block_used = 0;
+}
+
+YTDLP_Video_Metadata* Search_Results::append(YTDLP_Video_Metadata&& metadata) {
+    if (block_used == block_capacity) reserve_batch(std::max<size_t>(block_capacity, PaginationManager::SEARCH_PAGE_SIZE));
+    YTDLP_Video_Metadata* record = &blocks.back()[block_used++];
+    *record = std::move(metadata);
+    records.push_back(record);
+    return record;
+}
+
+bool Search_Results::contains(std::string_view video_id) const {
+    return std::any_of(records.begin(), records.end(), [video_id](const YTDLP_Video_Metadata* r) { return r->id == video_id; });
+}
+
+size_t Search_Results::footprint() const {
+    size_t total = sizeof(Search_Results) + records.capacity() * sizeof(YTDLP_Video_Metadata*);
+    for (const YTDLP_Video_Metadata* record: records) total += record->footprint();
+    // Room of the arena that is not used yet...
+    total += (block_capacity - block_used) * sizeof(YTDLP_Video_Metadata);
+    return total;
+}
+
+/** Parse the metadata printed by the exec of a yt-dlp command into @metadata. */
+void YtDlp_Helper::parse_metadata(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata){
+    std::stringstream lineStream{std::string(ytdlp_video_metadata)};
     std::string keyvalue;
 
     // Find metadata key=value delimited by ">>" symbols...
@@ -34,168 +222,567 @@ YTDLP_Video_Metadata* YtDlp_Helper::parse_metadata(const char ytdlp_video_metada
             if (pos != std::string::npos) {
                 std::string key = keyvalue.substr(0, pos);
                 std::string value = keyvalue.substr(pos + 2, keyvalue.size() - pos - 3); // Remove quotes
-                //printf("key: %s, value: %s\n", key.c_str(), value.c_str());
-                if (key == "title") {
-                    metadata->title = value;
-                } else if (key == "video_id"){
-                    metadata->id = value;
-                } else if (key == "creators"){
-                    metadata->creators = value;
-                } else if (key == "upload_date"){
-                    metadata->upload_date = value;
-                } else if (key == "duration"){
-                    metadata->duration = value;
-                } else if (key == "thumbnail"){
-                    metadata->thumbnail_url = value;
-                } else if (key == "channel_id"){
-                    metadata->channel_id = value;
-                } else if (key == "live_status"){
-                    metadata->live_status = value;
-                } else if (key == "is_live"){
-                    std::string lw_val = value;
-                    std::transform(lw_val.begin(), lw_val.end(), lw_val.begin(), ::tolower);    //lowercase
-                    metadata->is_live = (lw_val == "true") ? true : false;
-                } else if (key == "viewers_count"){
-                    metadata->viewers_count = value;
-                } else if (key == "concurrent_viewers_count"){
-                    metadata->concurrent_viewers_count = value;
-                } else if (key == "followers"){
-                    metadata->channel_follower_count = value;
-                } else if (key == "like_count"){
-                    metadata->like_count = value;
-                }  else if (key == "timestamp"){
-                    metadata->timestamp = value;
-                }  else if (key == "timestamp_text"){
-                    metadata->timestamp_text = value;
-                }  else if (key == "media_type"){
-                    if (value == "video")   metadata->media_type = YT_VIDEO_TYPE::VIDEO;
-                    else if (value == "short")    metadata->media_type = YT_VIDEO_TYPE::SHORT;
-                    else if (value == "livestream")    metadata->media_type = YT_VIDEO_TYPE::LIVESTREAM;
-                    else metadata->media_type = YT_VIDEO_TYPE::UNKNONW;
-                }  else if (key == "category"){
-                    metadata->category = value;
-                }   else if (key == "description"){
-                    metadata->description = value;
-                }   else if (key == "tags"){
-                    if (value != "") metadata->tags = tokenize(value, ',');
-                }
+                set_metadata_field(&metadata, key, value);
             }
         }
     }
-    metadata->url =  YOUTUBE_URL_PREFIX + metadata->id;
-    return metadata;
+    metadata.url =  YOUTUBE_URL_PREFIX + metadata.id;
+}
+
+bool YtDlp_Helper::parse_json_metadata(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata) {
+    Metadata_Json_Handler handler(&metadata);
+    JsonSaxParser parser;
+    if (!parser.parse(ytdlp_video_metadata, handler)) return false;
+    metadata.url =  YOUTUBE_URL_PREFIX + metadata.id;
+    return true;
+}
+
+bool YtDlp_Helper::parse_metadata_output(std::string_view ytdlp_video_metadata, YTDLP_Video_Metadata& metadata) {
+    if (metadata_format == YT_METADATA_FORMAT::METADATA_TEXT) {
+        parse_metadata(ytdlp_video_metadata, metadata);
+        return true;
+    }
+    if (!parse_json_metadata(ytdlp_video_metadata, metadata)) {
+        logger->warn(_("Cannot parse the video metadata printed by yt-dlp: ") + std::string(ytdlp_video_metadata.substr(0, 128)));
+        return false;
+    }
+    return true;
 }
 
 std::string YtDlp_Helper::getIdFor(std::string video_url) {
     return video_url + ":" + std::to_string(this->video_resolution);
 }
 
-std::vector<YTDLP_Video_Metadata*> YtDlp_Helper::retrieve_metadata(const char* ytdlp_cmd) {
-    logger->debug(ytdlp_cmd);
-    std::string result = exec(ytdlp_cmd);
+void YtDlp_Helper::start_persistent_workers(unsigned int count) {
+    worker_pool.reset();
+    if (count == 0) return;
+    worker_pool = std::make_unique<YtDlp_Worker_Pool>(count, YTDLP_BIN_PATH, TEMP_WORKING_DIR + "ytdlp_errors.log", logger);
+    logger->debug("Persistent yt-dlp workers requested: " + std::to_string(count));
+}
+
+void YtDlp_Helper::run_ytdlp(const std::vector<std::string>& ytdlp_args, const ytdlp_line_handler& on_line, int& exit_status, Cancellation_Token* token) {
+    exit_status = -1;
+    if (token != nullptr && token->is_cancelled()) return;
+    if (worker_pool != nullptr && worker_pool->is_enabled()) {
+        logger->debug("EXEC COMMAND (persistent worker) = " + YTDLP_BIN_PATH + " " + join_shell_args(ytdlp_args));
+        if (worker_pool->run(ytdlp_args, on_line, exit_status, token, call_timeout_ms)) return;
+        if (token != nullptr && token->is_cancelled()) return;
+    }
+    // Fallback: run a new yt-dlp process...
+    std::vector<std::string> argv = { YTDLP_BIN_PATH };
+    argv.insert(argv.end(), ytdlp_args.begin(), ytdlp_args.end());
+    Process_Options options;
+    options.timeout_ms = call_timeout_ms;
+    options.stderr_path = TEMP_WORKING_DIR + "ytdlp_errors.log";
+    options.token = token;
+    exit_status = process_manager.run(argv, on_line, options).exit_status;
+}
+
+std::string YtDlp_Helper::run_ytdlp(const std::vector<std::string>& ytdlp_args, int& exit_status, Cancellation_Token* token) {
+    std::string result;
+    result.reserve(8 * 1024);
+    run_ytdlp(ytdlp_args, [&result](const std::string& line) {
+        result.append(line);
+        result.push_back('\n');
+    }, exit_status, token);
+    return result;
+}
+
+std::vector<std::string> YtDlp_Helper::search_args(const std::string& target, int start, int end) {
+    return { target, "-I", std::to_string(start) + "-" + std::to_string(end), "--flat-playlist",
+             "--print", get_metadata_template(), "--extractor-args", "youtubetab:approximate_date" };
+}
+
+std::vector<YTDLP_Video_Metadata*> YtDlp_Helper::retrieve_metadata(const std::vector<std::string>& ytdlp_args, Cancellation_Token* token) {
+    int exit_status;
+    std::string result = run_ytdlp(ytdlp_args, exit_status, token);
     std::vector<YTDLP_Video_Metadata*> metadata;
     logger->debug(result);
     // Read input lines until an empty line is encountered
     std::istringstream result_sstream(result);
     std::string line;
-    if (this->metadata_profile == YT_METADATA_PROFILE::DETAILED) {
-        line = result_sstream.str();
-        metadata.push_back(YtDlp_Helper::parse_metadata(line.c_str()));
+    YTDLP_Video_Metadata* video_m;
+    // The detailed text template can print multiline values (i.e. the description), so it's parsed as a whole.
+    if (this->metadata_profile == YT_METADATA_PROFILE::DETAILED && this->metadata_format == YT_METADATA_FORMAT::METADATA_TEXT) {
+        video_m = new YTDLP_Video_Metadata();
+        YtDlp_Helper::parse_metadata(result, *video_m);
+        metadata.push_back(video_m);
     } else {
         getline(result_sstream, line);
         while (!line.empty()) {
             //Set the video metadata at the array...
-            metadata.push_back(YtDlp_Helper::parse_metadata(line.c_str()));
+            video_m = new YTDLP_Video_Metadata();
+            if (parse_metadata_output(line, *video_m)) {
+                metadata.push_back(video_m);
+            } else {
+                delete video_m;
+            }
             getline(result_sstream, line);
         }
     }
     return metadata;
 }
 
+void YtDlp_Helper::load_search_batch(const std::string cache_key, const std::string persisted_key, const std::vector<std::string> ytdlp_args,
+                                     std::shared_ptr<Cancellation_Token> token) {
+    int exit_status;
+    size_t count_added = 0;
+    // Results printed by yt-dlp, by id: a fallback to a new yt-dlp process could print again the results printed
+    // before a worker crash, so the repeated ones are only counted once.
+    std::set<std::string> printed_ids;
+    std::shared_ptr<Search_Results> results;
+    {
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        results = cached_search_results(cache_key);
+    }
+    auto start_time = std::chrono::steady_clock::now();
+    run_ytdlp(ytdlp_args, [&](const std::string& line) {
+        if (line.empty()) return;
+        logger->debug(line);
+        YTDLP_Video_Metadata video_m;
+        if (!parse_metadata_output(line, video_m)) return;
+        printed_ids.insert(video_m.id);
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        if (results->contains(video_m.id)) return;
+        results->append(std::move(video_m));
+        count_added++;
+        search_cache_updated.notify_all();
+    }, exit_status, token.get());
+
+    if (count_added > 0) search_cache.record_resolve_time(elapsed_ms(start_time));
+    std::unique_lock<std::mutex> lock(search_cache_mutex);
+    // The results already shown by a previous batch still take their yt-dlp positions.
+    results->repeated_count += printed_ids.size() - count_added;
+    // Less results than requested means the end of the results list (unless yt-dlp failed or was interrupted).
+    if (exit_status == 0 && printed_ids.size() < batch_search_size) results->exhausted = true;
+    // Put again, so the size of the new batch is counted at the cache capacity.
+    search_cache.put(cache_key, results);
+    search_in_flight.erase(cache_key);
+    search_cache_updated.notify_all();
+    logger->debug("Search batch loaded for '" + cache_key + "': " + std::to_string(count_added) + " new results (yt-dlp exit status " + std::to_string(exit_status) + ").");
+    if (count_added == 0 || search_cache_dir.empty()) return;
+    std::string content = serialize_search(persisted_key, *results);
+    lock.unlock();
+    write_persisted_search(persisted_key, content);
+}
+
+std::vector<std::string> YtDlp_Helper::next_batch_args(const std::string& search_text, size_t cached_count) {
+    int start = cached_count + 1;
+    int end = cached_count + batch_search_size;
+    // A search by term must request enough results to include the new batch. A channel URL is used as is.
+    std::string target = (search_type == SEARCH_BY_TYPE::TERM) ? "ytsearch" + std::to_string(end) + ":" + search_text : search_text;
+    return search_args(target, start, end);
+}
+
+void YtDlp_Helper::prefetch_next_batch(const std::string& search_text, Search_Results& results, const Pagination_Info& page) {
+    if (prefetch_lookahead_pages == 0 || thread_pool == nullptr || results.exhausted || search_in_flight.count(search_text) > 0) return;
+    if (results.size() >= page.upper_end() + prefetch_lookahead_pages * PaginationManager::SEARCH_PAGE_SIZE) return;
+
+    std::vector<std::string> ytdlp_args = next_batch_args(search_text, results.ytdlp_count());
+    std::string persisted_key = persisted_search_key(search_text);
+    search_in_flight.insert(search_text);
+    prefetch_queued.insert(search_text);
+    speculative_tasks++;
+    bool submitted = thread_pool->submit(LANE_SPECULATIVE, [this, search_text, persisted_key, ytdlp_args, token = prefetch_token]() {
+        {
+            std::lock_guard<std::mutex> lock(search_cache_mutex);
+            // If a search claimed this batch, it is already loading it (and its key was removed from @search_in_flight)...
+            bool claimed = (prefetch_queued.erase(search_text) == 0);
+            if (claimed || token->is_cancelled()) {
+                if (!claimed) search_in_flight.erase(search_text);
+                speculative_tasks--;
+                search_cache_updated.notify_all();
+                return;
+            }
+        }
+        logger->debug("Prefetching the next search batch for '" + search_text + "'.");
+        load_search_batch(search_text, persisted_key, ytdlp_args, token);
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        speculative_tasks--;
+        search_cache_updated.notify_all();
+    });
+    if (submitted) {
+        results.reserve_batch(batch_search_size);
+    } else {
+        // The speculative lane is full, so try again with the next page.
+        search_in_flight.erase(search_text);
+        prefetch_queued.erase(search_text);
+        speculative_tasks--;
+    }
+}
+
+std::shared_ptr<Search_Results> YtDlp_Helper::cached_search_results(const std::string& cache_key, bool load_persisted) {
+    std::shared_ptr<Search_Results> results;
+    if (search_cache.get(cache_key, results)) return results;
+    results = std::make_shared<Search_Results>();
+    bool loaded = false;
+    std::string persisted_key;
+    if (load_persisted && !search_cache_dir.empty()) {
+        persisted_key = persisted_search_key(cache_key);
+        loaded = load_persisted_search(persisted_key, *results);
+    }
+    search_cache.put(cache_key, results);
+    // A search evicted from the cache is not added again to the history.
+    if (std::find(search_history.begin(), search_history.end(), cache_key) == search_history.end()) search_history.push_back(cache_key);
+    if (!loaded || !refresh_persisted_searches || thread_pool == nullptr) return results;
+
+    // The persisted results are shown now, and the first batch is retrieved again at background to add the new ones.
+    std::vector<std::string> ytdlp_args = next_batch_args(cache_key, 0);
+    speculative_tasks++;
+    bool submitted = thread_pool->submit(LANE_SPECULATIVE, std::bind(&YtDlp_Helper::refresh_persisted_search, this, cache_key,
+                                                                     persisted_key, ytdlp_args, results, prefetch_token));
+    if (!submitted) speculative_tasks--;
+    return results;
+}
+
+std::string YtDlp_Helper::persisted_search_key(const std::string& search_text) {
+    return std::to_string(metadata_profile) + ":" + search_text;
+}
+
+std::string YtDlp_Helper::persisted_search_path(const std::string& persisted_key) {
+    // FNV-1a hash of the key, so any search text is a valid file name.
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c: persisted_key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.search", static_cast<unsigned long long>(hash));
+    return search_cache_dir + "/" + name;
+}
+
+/* Read the header line of a persisted search file. Returns false if it is not a valid header. */
+static bool parse_persisted_search_header(const std::string& line, time_t& saved_date, bool& exhausted, std::string& persisted_key) {
+    const std::string& header = YtDlp_Helper::PERSISTED_SEARCH_HEADER;
+    if (line.compare(0, header.size(), header) != 0 || line.size() <= header.size() || line[header.size()] != '\t') return false;
+    size_t date_end = line.find('\t', header.size() + 1);
+    if (date_end == std::string::npos || date_end + 2 >= line.size() || line[date_end + 2] != '\t') return false;
+    long long date = YtDlp_Helper::parse_metadata_number(std::string_view(line).substr(header.size() + 1, date_end - header.size() - 1));
+    if (date < 0) return false;
+    saved_date = static_cast<time_t>(date);
+    exhausted = (line[date_end + 1] == '1');
+    persisted_key = line.substr(date_end + 3);
+    return true;
+}
+
+bool YtDlp_Helper::load_persisted_search(const std::string& persisted_key, Search_Results& results) {
+    std::ifstream file(persisted_search_path(persisted_key));
+    if (!file.is_open()) return false;
+    std::string line, saved_key;
+    time_t saved_date;
+    bool exhausted;
+    // A different key means a collision of the file name hash.
+    if (!getline(file, line) || !parse_persisted_search_header(line, saved_date, exhausted, saved_key) || saved_key != persisted_key) return false;
+    if (time(0) - saved_date > static_cast<time_t>(search_cache_ttl)) return false;
+    while (getline(file, line)) {
+        if (line.empty()) continue;
+        YTDLP_Video_Metadata video_m;
+        if (parse_json_metadata(line, video_m) && !video_m.id.empty() && !results.contains(video_m.id)) results.append(std::move(video_m));
+    }
+    if (results.size() == 0) return false;
+    results.exhausted = exhausted;
+    logger->debug("Search '" + persisted_key + "' loaded from disk: " + std::to_string(results.size()) + " results, saved "
+                  + std::to_string((time(0) - saved_date) / 60) + " minutes ago.");
+    return true;
+}
+
+static const char* live_status_name(YT_LIVE_STATUS status) {
+    switch (status) {
+        case YT_LIVE_STATUS::NOT_LIVE:      return "not_live";
+        case YT_LIVE_STATUS::IS_LIVE:       return "is_live";
+        case YT_LIVE_STATUS::IS_UPCOMING:   return "is_upcoming";
+        case YT_LIVE_STATUS::WAS_LIVE:      return "was_live";
+        case YT_LIVE_STATUS::POST_LIVE:     return "post_live";
+        default:                            return nullptr;
+    }
+}
+
+static const char* media_type_name(YT_VIDEO_TYPE type) {
+    switch (type) {
+        case YT_VIDEO_TYPE::VIDEO:          return "video";
+        case YT_VIDEO_TYPE::SHORT:          return "short";
+        case YT_VIDEO_TYPE::LIVESTREAM:     return "livestream";
+        default:                            return nullptr;
+    }
+}
+
+std::string YtDlp_Helper::metadata_to_json(const YTDLP_Video_Metadata& metadata) {
+    auto number = [](long long value) {
+        return (value == METADATA_UNKNOWN_NUMBER) ? std::string("null") : std::to_string(value);
+    };
+    auto name = [](const char* value) {
+        return (value == nullptr) ? std::string("null") : json_string(value);
+    };
+    std::string json = "{\"title\":" + json_string(metadata.title) + ",\"video_id\":" + json_string(metadata.id)
+        + ",\"creators\":" + json_string(metadata.creators) + ",\"upload_date\":" + json_string(metadata.upload_date)
+        + ",\"thumbnail\":" + json_string(metadata.thumbnail_url) + ",\"duration\":" + number(metadata.duration)
+        + ",\"channel_id\":" + json_string(metadata.channel_id) + ",\"live_status\":" + name(live_status_name(metadata.live_status))
+        + ",\"viewers_count\":" + number(metadata.viewers_count) + ",\"is_live\":" + (metadata.is_live ? "true" : "false")
+        + ",\"concurrent_viewers_count\":" + number(metadata.concurrent_viewers_count)
+        + ",\"followers\":" + number(metadata.channel_follower_count) + ",\"like_count\":" + number(metadata.like_count)
+        + ",\"timestamp\":" + number(metadata.timestamp) + ",\"timestamp_text\":" + json_string(metadata.timestamp_text)
+        + ",\"media_type\":" + name(media_type_name(metadata.media_type)) + ",\"category\":" + json_string(metadata.category)
+        + ",\"description\":" + json_string(metadata.description) + ",\"tags\":[";
+    for (size_t i = 0; i < metadata.tags.size(); i++) {
+        if (i > 0) json.push_back(',');
+        json += json_string(metadata.tags[i]);
+    }
+    json += "]}";
+    return json;
+}
+
+std::string YtDlp_Helper::serialize_search(const std::string& persisted_key, const Search_Results& results) {
+    std::string content = PERSISTED_SEARCH_HEADER + "\t" + std::to_string(time(0)) + "\t" + (results.exhausted ? "1" : "0")
+        + "\t" + persisted_key + "\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        content += metadata_to_json(*results.at(i));
+        content.push_back('\n');
+    }
+    return content;
+}
+
+void YtDlp_Helper::write_persisted_search(const std::string& persisted_key, const std::string& content) {
+    std::lock_guard<std::mutex> lock(persisted_search_mutex);
+    std::string path = persisted_search_path(persisted_key);
+    if (!write_file_atomically(path, content)) logger->warn(_("Cannot save the search results at: ") + path);
+}
+
+void YtDlp_Helper::refresh_persisted_search(const std::string cache_key, const std::string persisted_key, std::vector<std::string> ytdlp_args,
+                                            std::shared_ptr<Search_Results> persisted, std::shared_ptr<Cancellation_Token> token) {
+    Search_Results fresh;
+    std::set<std::string> printed_ids;
+    int exit_status = -1;
+    if (!token->is_cancelled()) {
+        logger->debug("Refreshing the search '" + cache_key + "' loaded from disk.");
+        fresh.reserve_batch(batch_search_size);
+        run_ytdlp(ytdlp_args, [&](const std::string& line) {
+            if (line.empty()) return;
+            YTDLP_Video_Metadata video_m;
+            if (!parse_metadata_output(line, video_m)) return;
+            printed_ids.insert(video_m.id);
+            if (!fresh.contains(video_m.id)) fresh.append(std::move(video_m));
+        }, exit_status, token.get());
+    }
+
+    std::unique_lock<std::mutex> lock(search_cache_mutex);
+    std::shared_ptr<Search_Results> current;
+    // The refresh is discarded if it failed, or if the search changed meanwhile (i.e. a new batch is loading for it).
+    bool merge = exit_status == 0 && fresh.size() > 0 && search_in_flight.count(cache_key) == 0
+        && search_cache.get(cache_key, current) && current == persisted;
+    std::string content;
+    if (merge) {
+        // A new object is cached, because the pages being shown keep pointers to the records of the persisted results.
+        std::shared_ptr<Search_Results> merged = std::make_shared<Search_Results>();
+        merged->reserve_batch(fresh.size() + persisted->size());
+        for (size_t i = 0; i < fresh.size(); i++) merged->append(std::move(*fresh.at(i)));
+        for (size_t i = 0; i < persisted->size(); i++) {
+            if (!merged->contains(persisted->at(i)->id)) merged->append(YTDLP_Video_Metadata(*persisted->at(i)));
+        }
+        merged->exhausted = persisted->exhausted || printed_ids.size() < batch_search_size;
+        // Positions already retrieved from yt-dlp; the rest are persisted results that are not at the first batch anymore.
+        merged->set_ytdlp_count(std::max(printed_ids.size(), persisted->ytdlp_count()));
+        search_cache.put(cache_key, merged);
+        content = serialize_search(persisted_key, *merged);
+        logger->debug("Search '" + cache_key + "' refreshed: " + std::to_string(merged->size() - persisted->size()) + " new results.");
+    }
+    speculative_tasks--;
+    search_cache_updated.notify_all();
+    lock.unlock();
+    if (!content.empty()) write_persisted_search(persisted_key, content);
+}
+
+void YtDlp_Helper::prune_persisted_searches() {
+    std::error_code error;
+    size_t removed = 0;
+    for (const auto& file: std::filesystem::directory_iterator(search_cache_dir, error)) {
+        if (!file.is_regular_file(error)) continue;
+        std::ifstream stream(file.path());
+        std::string line, persisted_key;
+        time_t saved_date;
+        bool exhausted;
+        bool valid = getline(stream, line) && parse_persisted_search_header(line, saved_date, exhausted, persisted_key);
+        stream.close();
+        if (valid && time(0) - saved_date <= static_cast<time_t>(search_cache_ttl)) continue;
+        if (std::filesystem::remove(file.path(), error)) removed++;
+    }
+    if (removed > 0) logger->debug("Removed " + std::to_string(removed) + " expired searches from: " + search_cache_dir);
+}
+
+void YtDlp_Helper::set_search_persistence(const std::string& dirname, unsigned int ttl_seconds, bool refresh) {
+    std::lock_guard<std::mutex> lock(search_cache_mutex);
+    search_cache_dir.clear();
+    search_cache_ttl = ttl_seconds;
+    refresh_persisted_searches = refresh;
+    if (dirname.empty() || ttl_seconds == 0) return;
+    std::error_code error;
+    std::filesystem::create_directories(dirname, error);
+    if (!std::filesystem::is_directory(dirname, error)) {
+        logger->warn(_("Cannot create the directory to save the search results: ") + dirname);
+        return;
+    }
+    search_cache_dir = dirname;
+    prune_persisted_searches();
+}
+
+void YtDlp_Helper::keep_returned_results(std::shared_ptr<void> results) {
+    if (!returned_results.empty() && returned_results.back() == results) return;
+    returned_results.push_back(results);
+    if (returned_results.size() > RETURNED_RESULTS_KEPT) returned_results.pop_front();
+}
+
 /**
  * Make a search by term in the specified extractor (i.e. "youtube", etc.). See a complete list of extractors at yt-dlp docs.
  * For now, only do searchs at Youtube.
  */
 yt_metadata_arr YtDlp_Helper::search(const char* search_term, Pagination_Info page_info){
+    std::lock_guard<std::mutex> lock(search_mutex);
+    return run_search(search_term, page_info, nullptr);
+}
+
+std::shared_ptr<Search_Request> YtDlp_Helper::search_async(const char* search_term, Pagination_Info page_info, SEARCH_BY_TYPE type,
+                                                           YT_METADATA_PROFILE profile, search_done_handler on_done) {
+    std::shared_ptr<Search_Request> request = std::make_shared<Search_Request>();
+    {
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        running_searches++;
+    }
+    auto search_f = [this, request, on_done, type, profile, page_info](const std::string search_text) {
+        {
+            // A previous search could still be running, if it was cancelled but its yt-dlp process is ending...
+            std::lock_guard<std::mutex> lock(search_mutex);
+            if (!request->is_cancelled()) {
+                this->search_type = type;
+                this->metadata_profile = profile;
+                request->results = run_search(search_text.c_str(), page_info, request->token);
+            }
+            request->finished.store(true);
+        }
+        if (request->is_cancelled()) logger->debug("Search cancelled: '" + search_text + "'.");
+        on_done(request);
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        running_searches--;
+        search_cache_updated.notify_all();
+    };
+    run_in_background(LANE_INTERACTIVE, std::bind(search_f, std::string(search_term)));
+    return request;
+}
+
+bool YtDlp_Helper::run_in_background(TASK_LANE lane, pool_task task) {
+    if (thread_pool != nullptr && thread_pool->submit(lane, task)) return true;
+    if (lane != LANE_INTERACTIVE) return false;
+    std::thread worker(task);
+    worker.detach();
+    return true;
+}
+
+yt_metadata_arr YtDlp_Helper::run_search(const char* search_term, Pagination_Info page_info, std::shared_ptr<Cancellation_Token> token){
     std::string clean_text = std::string(search_term);
     trim_and_clean(clean_text);
     if (this->extractor == YTDLP_EXTRACTOR::YOUTUBE) {
-        return this->do_youtube_search(clean_text.c_str(), page_info);
+        return this->do_youtube_search(clean_text.c_str(), page_info, token);
     } else {
         return {};
     }
 }
 
-yt_metadata_arr YtDlp_Helper::do_youtube_search(const char* search_text ,Pagination_Info page_info){
-    char search_component[128];
+yt_metadata_arr YtDlp_Helper::do_youtube_search(const char* search_text ,Pagination_Info page_info, std::shared_ptr<Cancellation_Token> token){
+    std::string search_component;
     yt_metadata_arr result_yt_metadata;
     result_yt_metadata.fill(nullptr);
     std::vector<YTDLP_Video_Metadata*> mtd;
     Pagination_Info page_info_ = page_info;
-    // Define search yt-dlp command, that will be used if necessary...
+    // Define search yt-dlp arguments, that will be used if necessary...
     switch (this->search_type) {
         case SEARCH_BY_TYPE::CHANNEL_URL:
-            snprintf(search_component, sizeof(search_component), "%s", search_text);  //The term is a Channel URL...
+            search_component = search_text;  //The term is a Channel URL...
             break;
         case SEARCH_BY_TYPE::VIDEO_URL:
-            strcpy(search_component, search_text);
+            search_component = search_text;
             page_info_ = Pagination_Info(1,0);
             break;
         case SEARCH_BY_TYPE::TERM:
             // Else, do a normal search by term.
             break;
     }
-    char ytdlp_cmd[1024];
-    char cmd_format[1024] = "%s \"%s\" -I %d-%d --flat-playlist --print \"%s\" --extractor-args youtubetab:approximate_date";
 
     // Check if exists cached results for this type of search...
     if (search_type != SEARCH_BY_TYPE::VIDEO_URL) {
-        auto search_data = search_cache.find(search_text);
-        // If not cached, OR have to get more results, then retrieve and cache new results...
-        if (search_data == search_cache.end()
-                || (search_data != search_cache.end() && search_data->second.size() < page_info_.upper_end())) {
-
-            int start, end;
-            if (search_data == search_cache.end()) {
-                search_cache[search_text] = {};
-                search_data = search_cache.find(search_text);
-                start = 1; end = batch_search_size;
-                search_history.push_back(search_text);
-            } else {
-                start = search_data->second.size();
-                end = search_data->second.size() + batch_search_size;
-            }
-
-            if ( search_type == SEARCH_BY_TYPE::TERM) {
-                snprintf(search_component, sizeof(search_component), "ytsearch%d:%s", end, search_text);
+        std::unique_lock<std::mutex> lock(search_cache_mutex);
+        // The background tasks started for the previous search are not useful anymore.
+        if (prefetch_search_text != search_text) {
+            prefetch_token->cancel();
+            prefetch_token = std::make_shared<Cancellation_Token>();
+            prefetch_search_text = search_text;
+        }
+        std::shared_ptr<Search_Results> results = cached_search_results(search_text, true);
+        auto page_available = [&]() {
+            return results->size() >= page_info_.upper_end() || search_in_flight.count(search_text) == 0;
+        };
+        auto wait_page = [&]() {
+            // The batch being loaded could belong to another search, so a cancellation must be checked periodically.
+            while (!page_available() && !(token != nullptr && token->is_cancelled())) {
+                search_cache_updated.wait_for(lock, std::chrono::milliseconds(200));
             }
-            snprintf(ytdlp_cmd, sizeof(ytdlp_cmd), cmd_format, YTDLP_BIN_PATH.c_str(), search_component, start, end, get_metadata_template().c_str());
-            mtd = retrieve_metadata(ytdlp_cmd);
+        };
+        // A prefetch of the needed batch that is still queued is claimed, so it is loaded now as interactive work...
+        if (results->size() < page_info_.upper_end() && prefetch_queued.erase(search_text) > 0) {
+            search_in_flight.erase(search_text);
+        }
+        // If a batch for this search is loading, wait until it contains the requested page or finishes...
+        wait_page();
+        if (token != nullptr && token->is_cancelled()) return result_yt_metadata;
 
-            for ( YTDLP_Video_Metadata* video_m: mtd) {
-                search_data->second.push_back(std::make_pair(video_m->id, video_m));
+        // If have to get more results (and the search has more), then retrieve and cache a new batch...
+        if (results->size() < page_info_.upper_end() && !results->exhausted) {
+            search_in_flight.insert(search_text);
+            results->reserve_batch(batch_search_size);
+            std::vector<std::string> ytdlp_args = next_batch_args(search_text, results->ytdlp_count());
+            std::string persisted_key = persisted_search_key(search_text);
+            if (streamed_search) {
+                // The loader gets its own thread: at the pool, it could be queued behind this search (that waits for it
+                // holding a worker) and the other interactive tasks (i.e. a stream, or searches waiting for @search_mutex).
+                // It is waited for at the destructor through @search_in_flight.
+                std::thread loader(std::bind(&YtDlp_Helper::load_search_batch, this, std::string(search_text), persisted_key, ytdlp_args, token));
+                loader.detach();
+                wait_page();
+            } else {
+                lock.unlock();
+                load_search_batch(search_text, persisted_key, ytdlp_args, token);
+                lock.lock();
             }
         }
-        auto search_cached_results = search_data->second;
         int retrieve_position;
         for (int i=0; i < PaginationManager::SEARCH_PAGE_SIZE; i++) {
             retrieve_position = (page_info_.lower_end() - 1) + i;
-            if (retrieve_position < search_cached_results.size()) {
-                result_yt_metadata[i] = search_cached_results[retrieve_position].second;
+            if (retrieve_position < results->size()) {
+                result_yt_metadata[i] = results->at(retrieve_position);
             }
         }
+        keep_returned_results(results);
+        if (!(token != nullptr && token->is_cancelled())) prefetch_next_batch(search_text, *results, page_info_);
     } else {
-        // If search only one video (SEARCH_BY_TYPE::VIDEO_URL), then get its metadata...
-        snprintf(ytdlp_cmd, sizeof(ytdlp_cmd), cmd_format, YTDLP_BIN_PATH.c_str(), search_component,
-                 page_info_.lower_end(), page_info_.upper_end(), get_metadata_template().c_str());
-        mtd = retrieve_metadata(ytdlp_cmd);
-        if (!mtd.empty()) result_yt_metadata[0] = mtd[0];
+        // If search only one video (SEARCH_BY_TYPE::VIDEO_URL), then get its metadata (unless it was retrieved recently)...
+        std::string cache_key = std::to_string(metadata_profile) + ":" + search_component;
+        Cached_Video_Metadata cached;
+        if (!video_metadata_cache.get(cache_key, cached)) {
+            auto start_time = std::chrono::steady_clock::now();
+            mtd = retrieve_metadata(search_args(search_component, page_info_.lower_end(), page_info_.upper_end()), token.get());
+            if (mtd.empty()) return result_yt_metadata;
+            video_metadata_cache.record_resolve_time(elapsed_ms(start_time));
+            cached.metadata = std::shared_ptr<YTDLP_Video_Metadata>(mtd[0]);
+            cached.expiration = time(0) + VIDEO_METADATA_TTL;
+            for (size_t i = 1; i < mtd.size(); i++) delete mtd[i];
+            video_metadata_cache.put(cache_key, cached);
+        }
+        result_yt_metadata[0] = cached.metadata.get();
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        keep_returned_results(cached.metadata);
     }
     return result_yt_metadata;
 }
 
-std::string YtDlp_Helper::get_stream_url(const char* video_url, const char* stream_format, bool &is_dash_format, std::vector<std::string> &urls, std::string alt_player_client) {
-    char get_final_url_cmd[2048];
+std::string YtDlp_Helper::get_stream_url(const char* video_url, const char* stream_format, bool &is_dash_format, std::vector<std::string> &urls,
+                                         std::string alt_player_client, Cancellation_Token* token, bool* from_cache) {
     std::string final_url_result;
     urls.clear();
     is_dash_format = false;
@@ -203,17 +790,20 @@ std::string YtDlp_Helper::get_stream_url(const char* video_url, const char* stre
     // If video is not live, 1rst try to obtain final video URL using default method...
     // 1rst: lookup final video URL if exists at cache...
     final_url_result = cache->get_entry_value(getIdFor(video_url));
+    if (from_cache != nullptr) *from_cache = (final_url_result != CacheEntry::EMPTY_VALUE);
     if (final_url_result == CacheEntry::EMPTY_VALUE) {
-        std::string alt_player_arg = "";
+        // 2nd: if final video url is not cached, then obtain it using yt-dlp.
+        std::vector<std::string> ytdlp_args = { "-S", stream_format, "-g", video_url };
         if (alt_player_client != "") {
-            alt_player_arg = "--extractor-args \"youtube:player_client=" + alt_player_client + "\"";
+            ytdlp_args.push_back("--extractor-args");
+            ytdlp_args.push_back("youtube:player_client=" + alt_player_client);
         }
-        // 2nd: if final video url is not cached, then obtain it using yt-dlp.
-        snprintf(get_final_url_cmd, sizeof(get_final_url_cmd), "%s -S \"%s\" -g \"%s\" %s 2> %s/ytdlp_errors.log",
-                 YTDLP_BIN_PATH.c_str(), stream_format, video_url, alt_player_arg.c_str(), this->TEMP_WORKING_DIR.c_str());
-        this->logger->debug("EXEC COMMAND = " + std::string(get_final_url_cmd) + "\n");
-        final_url_result = exec(get_final_url_cmd);
+        int exit_status;
+        auto start_time = std::chrono::steady_clock::now();
+        final_url_result = run_ytdlp(ytdlp_args, exit_status, token);
+        if (token != nullptr && token->is_cancelled()) final_url_result = "";
         urls = tokenize(final_url_result, '\n');
+        if (!urls.empty()) cache->record_resolve_time(elapsed_ms(start_time));
     } else {
         urls = tokenize(final_url_result, DASH_URL_CACHE_SEPARATOR);
     }
@@ -242,64 +832,340 @@ std::string YtDlp_Helper::get_stream_url(const char* video_url, const char* stre
     return final_url_result;
 }
 
-FLTUBE_STATUS_CODES YtDlp_Helper::stream(const char* video_url) {
-    char stream_videoplayer_cmd[3072];
-    char stream_format[100];
-    std::string final_url_result;
-    snprintf(stream_format, sizeof(stream_format), "res:%d,+codec:avc1:m4a", this->video_resolution);
-    if (this->is_live_flag) {
-        snprintf(stream_videoplayer_cmd, sizeof(stream_videoplayer_cmd),
-                 "%s -S \"%s\" -o - \"%s\" | %s %s %s -", YTDLP_BIN_PATH.c_str(), stream_format, video_url, this->media_player->getBinaryPath().c_str(), this->media_player->getParams().c_str(), this->media_player->getExtraParams().c_str());
-    } else {
+std::string YtDlp_Helper::stream_format_sort() {
+    return "res:" + std::to_string(this->video_resolution) + ",+codec:avc1:m4a";
+}
+
+void YtDlp_Helper::resolve_stream_urls(const std::vector<std::string>& video_urls) {
+    std::shared_ptr<Cancellation_Token> token = std::make_shared<Cancellation_Token>();
+    {
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        stream_url_token->cancel();
+        stream_url_token = token;
+    }
+    if (stream_url_prefetch_per_page == 0 || thread_pool == nullptr) return;
+
+    // Videos already cached don't need to be resolved. The remaining ones are distributed between the concurrent tasks.
+    std::vector<std::vector<std::string>> task_urls(stream_url_prefetch_concurrency);
+    size_t count = 0;
+    for (const std::string& video_url: video_urls) {
+        if (count >= stream_url_prefetch_per_page) break;
+        if (!needs_stream_url(video_url)) continue;
+        task_urls[count % task_urls.size()].push_back(video_url);
+        count++;
+    }
+    for (const std::vector<std::string>& urls: task_urls) {
+        if (urls.empty()) continue;
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        speculative_tasks++;
+        if (!thread_pool->submit(LANE_SPECULATIVE, std::bind(&YtDlp_Helper::resolve_stream_urls_task, this, urls, token))) {
+            speculative_tasks--;
+        }
+    }
+}
+
+std::vector<std::string> YtDlp_Helper::player_clients_by_score() {
+    std::vector<std::string> player_clients = { "" };
+    player_clients.insert(player_clients.end(), alt_player_clients.begin(), alt_player_clients.end());
+    std::lock_guard<std::mutex> lock(player_client_mutex);
+    // Rank 0: last stream succeeded, 1: not used yet, 2: last stream failed.
+    auto rank = [this](const std::string& client) -> std::pair<int, time_t> {
+        auto score = player_client_scores.find(client);
+        if (score == player_client_scores.end()) return { 1, 0 };
+        const Player_Client_Score& s = score->second;
+        if (s.last_success > 0 && s.last_success >= s.last_failure) return { 0, -s.last_success };
+        return { 2, s.last_failure };
+    };
+    std::stable_sort(player_clients.begin(), player_clients.end(), [&rank](const std::string& a, const std::string& b) {
+        return rank(a) < rank(b);
+    });
+    return player_clients;
+}
+
+void YtDlp_Helper::record_player_client(const std::string& player_client, bool succeeded) {
+    {
+        std::lock_guard<std::mutex> lock(player_client_mutex);
+        Player_Client_Score& score = player_client_scores[player_client];
+        if (succeeded) {
+            score.successes++;
+            score.last_success = time(0);
+        } else {
+            score.failures++;
+            score.last_failure = time(0);
+        }
+        if (player_client_scores_path.empty() || player_client_save_pending) return;
+        player_client_save_pending = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        speculative_tasks++;
+    }
+    // Not written at the stream path: a stream only waits for the scores to be updated.
+    pool_task save = [this]() {
+        save_player_client_scores();
+        std::lock_guard<std::mutex> lock(search_cache_mutex);
+        speculative_tasks--;
+        search_cache_updated.notify_all();
+    };
+    if (!run_in_background(LANE_HOUSEKEEPING, save)) save();
+}
+
+void YtDlp_Helper::save_player_client_scores() {
+    // Taken first, so the scores written last are the latest ones.
+    std::lock_guard<std::mutex> file_lock(player_client_file_mutex);
+    std::string path, content;
+    {
+        std::lock_guard<std::mutex> lock(player_client_mutex);
+        // The scores recorded from now on need another save.
+        player_client_save_pending = false;
+        path = player_client_scores_path;
+        // The yt-dlp default client is saved as "default" (the name yt-dlp itself gives to it).
+        for (const auto& [client, s]: player_client_scores) {
+            content += (client.empty() ? "default" : client) + "\t" + std::to_string(s.successes) + "\t" + std::to_string(s.failures)
+                + "\t" + std::to_string(static_cast<long long>(s.last_success)) + "\t" + std::to_string(static_cast<long long>(s.last_failure)) + "\n";
+        }
+    }
+    if (!write_file_atomically(path, content)) logger->warn(_("Cannot save the player client scores at: ") + path);
+}
+
+void YtDlp_Helper::set_player_client_scores_path(const std::string& path) {
+    std::lock_guard<std::mutex> lock(player_client_mutex);
+    player_client_scores_path = path;
+    std::ifstream file(path);
+    std::string line;
+    while (getline(file, line)) {
+        std::vector<std::string> fields = tokenize(line, '\t');
+        if (fields.size() != 5) continue;
+        Player_Client_Score& score = player_client_scores[(fields[0] == "default") ? "" : fields[0]];
+        score.successes = std::max(0LL, parse_metadata_number(fields[1]));
+        score.failures = std::max(0LL, parse_metadata_number(fields[2]));
+        score.last_success = std::max(0LL, parse_metadata_number(fields[3]));
+        score.last_failure = std::max(0LL, parse_metadata_number(fields[4]));
+    }
+    if (!player_client_scores.empty()) logger->debug("Player client scores loaded from: " + path);
+}
+
+FLTUBE_STATUS_CODES YtDlp_Helper::race_player_clients(const char* video_url, const char* stream_format, const std::vector<std::string>& player_clients,
+                                                      std::string& final_url, bool& is_dash_format, std::vector<std::string>& urls) {
+    // Shared with the resolutions, because the ones that lose the race can end after this call returns.
+    struct Race_State {
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::vector<std::shared_ptr<Cancellation_Token>> tokens;
+        size_t running = 0;
+        bool won = false;
+        FLTUBE_STATUS_CODES result = FLT_HTTP_FORBIDDEN;
+        std::string final_url;
         bool is_dash_format = false;
         std::vector<std::string> urls;
-        final_url_result = this->get_stream_url(video_url, stream_format, is_dash_format, urls);
-
-        FLTUBE_STATUS_CODES res = check_url_access(urls[0]);
-        if (res != FLT_OK) {
-            for (std::string alt_player: this->alt_player_clients) {
-                if (res == FLT_HTTP_FORBIDDEN) {
-                    logger->debug(_("yt-dlp resolved to an INVALID URL (403 FORBIDDEN code was returned). Trying with another player_client: ") + alt_player);
-                    final_url_result = this->get_stream_url(video_url, stream_format, is_dash_format, urls, alt_player);
-                    res = check_url_access(urls[0]);
-                } else if (res == FLT_OK) {
-                    break;
+    };
+    std::shared_ptr<Race_State> race = std::make_shared<Race_State>();
+    for (size_t i = 0; i < player_clients.size(); i++) race->tokens.push_back(std::make_shared<Cancellation_Token>());
+    race->running = player_clients.size();
+    std::string url(video_url), format(stream_format);
+
+    for (size_t i = 0; i < player_clients.size(); i++) {
+        {
+            std::lock_guard<std::mutex> lock(search_cache_mutex);
+            speculative_tasks++;
+        }
+        // A thread by client: the pool workers could be busy running media players, while this one waits for the race.
+        std::thread resolution([this, race, i, url, format, player_client = player_clients[i]]() {
+            bool client_dash_format;
+            std::vector<std::string> client_urls;
+            bool from_cache;
+            Cancellation_Token* token = race->tokens[i].get();
+            std::string client_final_url = get_stream_url(url.c_str(), format.c_str(), client_dash_format, client_urls, player_client, token,
+                                                          &from_cache);
+            FLTUBE_STATUS_CODES res = client_urls.empty() ? FTL_HTTP_GENERAL_ERROR : check_url_access(client_urls[0]);
+            // A cancelled resolution (or a cached URL, resolved by any client) says nothing about its client.
+            if (!token->is_cancelled() && !from_cache && (res == FLT_OK || res == FLT_HTTP_FORBIDDEN)) {
+                record_player_client(player_client, res == FLT_OK);
+            }
+            {
+                std::lock_guard<std::mutex> lock(race->mutex);
+                if (!race->won && (res == FLT_OK || race->running == 1 || race->final_url.empty())) {
+                    // The winner, or the last result available (if no client works).
+                    race->result = res;
+                    race->final_url = client_final_url;
+                    race->is_dash_format = client_dash_format;
+                    race->urls = client_urls;
                 }
+                if (res == FLT_OK && !race->won) {
+                    race->won = true;
+                    logger->debug("Player client '" + player_client + "' won the stream URL resolution.");
+                    for (auto& other: race->tokens) if (other.get() != token) other->cancel();
+                }
+                race->running--;
+                race->finished.notify_all();
             }
+            std::lock_guard<std::mutex> lock(search_cache_mutex);
+            speculative_tasks--;
+            search_cache_updated.notify_all();
+        });
+        resolution.detach();
+    }
+
+    std::unique_lock<std::mutex> lock(race->mutex);
+    race->finished.wait(lock, [&race]() { return race->won || race->running == 0; });
+    final_url = race->final_url;
+    is_dash_format = race->is_dash_format;
+    urls = race->urls;
+    return race->result;
+}
+
+bool YtDlp_Helper::needs_stream_url(const std::string& video_url) {
+    Cache_Lookup cached = cache->peek(getIdFor(video_url));
+    return !cached.found || cached.expiration - time(0) < STREAM_URL_REFRESH_AHEAD;
+}
+
+time_t YtDlp_Helper::stream_url_expiration(const std::string& final_url) {
+    time_t expiration = 0;
+    for (const std::string& url: tokenize(final_url, DASH_URL_CACHE_SEPARATOR)) {
+        // Googlevideo URLs have the signature expiration as a query parameter, or as a path segment ("/expire/<date>/").
+        size_t position = url.find("expire=");
+        while (position != std::string::npos && position > 0 && url[position - 1] != '?' && url[position - 1] != '&') {
+            position = url.find("expire=", position + 1);
+        }
+        if (position != std::string::npos) {
+            position += std::string("expire=").size();
+        } else if ((position = url.find("/expire/")) != std::string::npos) {
+            position += std::string("/expire/").size();
+        } else {
+            continue;
         }
+        size_t end = url.find_first_not_of("0123456789", position);
+        long long url_expiration = parse_metadata_number(std::string_view(url).substr(position, end - position));
+        if (url_expiration <= 0) continue;
+        if (expiration == 0 || url_expiration < expiration) expiration = url_expiration;
+    }
+    return (expiration > 0) ? expiration - STREAM_URL_EXPIRY_MARGIN : 0;
+}
 
-        if (res != FLT_OK) {
-            logger->error(_("Cannot obtain a valid stream URL. Please check if your yt-dlp installation is up to date. More info at: ") + std::string("https://github.com/yt-dlp/yt-dlp/releases/latest"));
-            return res;
+void YtDlp_Helper::cancel_stream_url_resolution() {
+    std::lock_guard<std::mutex> lock(search_cache_mutex);
+    stream_url_token->cancel();
+}
+
+void YtDlp_Helper::resolve_stream_urls_task(const std::vector<std::string> video_urls, std::shared_ptr<Cancellation_Token> token) {
+    size_t count = resolve_stream_urls_batch(video_urls, token.get());
+    logger->debug(std::to_string(count) + " of " + std::to_string(video_urls.size()) + " stream URLs resolved at background.");
+    std::lock_guard<std::mutex> lock(search_cache_mutex);
+    speculative_tasks--;
+    search_cache_updated.notify_all();
+}
+
+size_t YtDlp_Helper::resolve_stream_urls_batch(const std::vector<std::string>& video_urls, Cancellation_Token* token) {
+    size_t count_cached = 0;
+    std::vector<std::string> pending;
+    for (size_t i = 0; i < video_urls.size(); i++) {
+        // A video could be streamed (so cached) while this batch was waiting...
+        if (needs_stream_url(video_urls[i])) pending.push_back(video_urls[i]);
+        if (pending.size() < MAX_URLS_PER_BATCH && i + 1 < video_urls.size()) continue;
+        if (pending.empty() || (token != nullptr && token->is_cancelled())) break;
+
+        // --ignore-errors: an unavailable video must not stop the resolution of the others.
+        std::vector<std::string> ytdlp_args = { "-S", stream_format_sort(), "--ignore-errors", "--print", STREAM_URLS_PRINT_TEMPLATE };
+        std::string player_client = player_clients_by_score().front();
+        if (!player_client.empty()) {
+            ytdlp_args.push_back("--extractor-args");
+            ytdlp_args.push_back("youtube:player_client=" + player_client);
         }
+        ytdlp_args.insert(ytdlp_args.end(), pending.begin(), pending.end());
+        int exit_status;
+        // Video URL, final URL and the first URL of the final one (the only one checked), of every video resolved.
+        std::vector<std::array<std::string, 3>> resolved;
+        auto start_time = std::chrono::steady_clock::now();
+        run_ytdlp(ytdlp_args, [&](const std::string& line) {
+            std::vector<std::string> fields = tokenize(line, '\t');
+            if (fields.size() < 2 || fields[1].empty() || fields[1] == "NA") return;
+            std::string final_url = fields[1];
+            if (fields.size() > 2 && !fields[2].empty()) final_url += DASH_URL_CACHE_SEPARATOR + fields[2];
+            resolved.push_back({ fields[0], final_url, fields[1] });
+        }, exit_status, token);
+        double batch_ms = elapsed_ms(start_time);
+        pending.clear();
+        if (resolved.empty() || (token != nullptr && token->is_cancelled())) continue;
 
-        if (final_url_result != "") {
-            // Once final URL is obtained, then open at configured Media Player...
-            if (is_dash_format) {
-                snprintf(stream_videoplayer_cmd, sizeof(stream_videoplayer_cmd),
-                    "ffmpeg -i \"%s\" -i \"%s\" -c copy -f nut - | %s %s -", urls.at(0).c_str(), urls.at(1).c_str(),
-                            this->media_player->getBinaryPath().c_str(), this->media_player->getParams().c_str());
-            } else {
-                snprintf(stream_videoplayer_cmd, sizeof(stream_videoplayer_cmd),
-                        "%s %s \"%s\"", this->media_player->getBinaryPath().c_str(), this->media_player->getParams().c_str(), final_url_result.c_str());
-            }
+        // Only accessible URLs are cached: a forbidden one must be resolved again (with another player client) by stream().
+        // They are checked at the same time, once yt-dlp ended, so its output is never waiting for a check.
+        std::vector<std::future<FLTUBE_STATUS_CODES>> accesses;
+        for (const auto& video: resolved) accesses.push_back(std::async(std::launch::async, check_url_access, video[2]));
+        for (size_t j = 0; j < resolved.size(); j++) {
+            if (accesses[j].get() != FLT_OK) continue;
+            cache->add_entry(getIdFor(resolved[j][0]), resolved[j][1], stream_url_expiration(resolved[j][1]));
+            // Every video of the batch is counted with the average time of the batch.
+            cache->record_resolve_time(batch_ms / resolved.size());
+            count_cached++;
+        }
+    }
+    return count_cached;
+}
+
+FLTUBE_STATUS_CODES YtDlp_Helper::stream(const char* video_url) {
+    char stream_format[100];
+    std::string final_url_result;
+    std::vector<std::string> player_argv = { this->media_player->getBinaryPath() };
+    for (const std::string& param: ProcessManager::split_args(this->media_player->getParams())) player_argv.push_back(param);
+    // The video to play was chosen, so the resolution of the other videos at background is not useful anymore.
+    cancel_stream_url_resolution();
+    snprintf(stream_format, sizeof(stream_format), "%s", stream_format_sort().c_str());
+    if (this->is_live_flag) {
+        for (const std::string& param: ProcessManager::split_args(this->media_player->getExtraParams())) player_argv.push_back(param);
+        player_argv.push_back("-");
+        process_manager.run_pipeline({ YTDLP_BIN_PATH, "-S", stream_format, "-o", "-", video_url }, player_argv);
+        return FLT_OK;
+    }
+
+    bool is_dash_format = false;
+    std::vector<std::string> urls;
+    // The player client that worked last is tried first...
+    std::vector<std::string> player_clients = player_clients_by_score();
+    bool from_cache;
+    final_url_result = this->get_stream_url(video_url, stream_format, is_dash_format, urls, player_clients[0], nullptr, &from_cache);
 
-            cache->add_entry(getIdFor(video_url), final_url_result);
+    FLTUBE_STATUS_CODES res = urls.empty() ? FTL_HTTP_GENERAL_ERROR : check_url_access(urls[0]);
+    // A cached URL could have been resolved by any client (i.e. by the prefetch, with the default one).
+    if (!from_cache && (res == FLT_OK || res == FLT_HTTP_FORBIDDEN)) record_player_client(player_clients[0], res == FLT_OK);
+    // ...and if its URL is forbidden, the other clients are tried at the same time. A forbidden cached URL says nothing
+    // about the first client, so it is tried again too.
+    size_t first_alternative = from_cache ? 0 : 1;
+    if (res == FLT_HTTP_FORBIDDEN && player_clients.size() > first_alternative) {
+        logger->debug(_("yt-dlp resolved to an INVALID URL (403 FORBIDDEN code was returned). Trying with the other player clients."));
+        cache->remove_entry(getIdFor(video_url));
+        std::vector<std::string> alternatives(player_clients.begin() + first_alternative, player_clients.end());
+        res = race_player_clients(video_url, stream_format, alternatives, final_url_result, is_dash_format, urls);
+    }
+
+    if (res != FLT_OK && !(final_url_result == "" && this->enable_alternative_stream_method)) {
+        logger->error(_("Cannot obtain a valid stream URL. Please check if your yt-dlp installation is up to date. More info at: ") + std::string("https://github.com/yt-dlp/yt-dlp/releases/latest"));
+        return res;
+    }
+
+    if (final_url_result != "") {
+        // Once final URL is obtained, then open at configured Media Player...
+        cache->add_entry(getIdFor(video_url), final_url_result, stream_url_expiration(final_url_result));
+        if (is_dash_format) {
+            player_argv.push_back("-");
+            process_manager.run_pipeline({ "ffmpeg", "-i", urls.at(0), "-i", urls.at(1), "-c", "copy", "-f", "nut", "-" }, player_argv);
         } else {
-            // If default method doesn't works, then try the alternative method (if configured this way)...
-            if (this->enable_alternative_stream_method) {
-                logger->warn(_("The default stream command doesn't work. Fallback to the alternative method to get final video URL."));
-                snprintf(stream_format, sizeof(stream_format), "bv*[height<=%d][vcodec^=avc]+ba[acodec^=mp4a]", this->video_resolution);
-                snprintf(stream_videoplayer_cmd, sizeof(stream_videoplayer_cmd),
-                    "%s -f \"%s\" -o - --merge-output-format mkv \"%s\" | %s %s -", YTDLP_BIN_PATH.c_str(), stream_format, video_url, this->media_player->getBinaryPath().c_str(), this->media_player->getParams().c_str());
-            } else {
-                logger->error(_("Cannot obtain URL for specified video, and alternative stream method is disabled."));
-                return FTL_HTTP_GENERAL_ERROR;
-            }
+            Process_Options player_options;
+            player_options.capture_output = false;
+            player_argv.push_back(final_url_result);
+            process_manager.run(player_argv, nullptr, player_options);
+        }
+    } else {
+        // If default method doesn't works, then try the alternative method (if configured this way)...
+        if (this->enable_alternative_stream_method) {
+            logger->warn(_("The default stream command doesn't work. Fallback to the alternative method to get final video URL."));
+            snprintf(stream_format, sizeof(stream_format), "bv*[height<=%d][vcodec^=avc]+ba[acodec^=mp4a]", this->video_resolution);
+            player_argv.push_back("-");
+            process_manager.run_pipeline({ YTDLP_BIN_PATH, "-f", stream_format, "-o", "-", "--merge-output-format", "mkv", video_url }, player_argv);
+        } else {
+            logger->error(_("Cannot obtain URL for specified video, and alternative stream method is disabled."));
+            return FTL_HTTP_GENERAL_ERROR;
         }
     }
-    this->logger->debug("EXEC COMMAND = " + std::string(stream_videoplayer_cmd) + "\n");
-    system(stream_videoplayer_cmd);
     return FLT_OK;
 }
 
@@ -308,25 +1174,23 @@ FLTUBE_STATUS_CODES YtDlp_Helper::stream(const char* video_url) {
  */
 void YtDlp_Helper::download_video(const char* video_url, const char* download_path, VCODEC_RESOLUTIONS v_resolution,
                     const char* vcodec = VIDEOCODEC_PREFERRED.c_str()){
-    char download_cmd[2048], s_dwl_data[200], s_dwl_dir[200];
+    char s_dwl_data[200];
     const char* download_data_format= "bestvideo[height<=%d][vcodec^=%s]+bestaudio/best";
-    const char* download_dir_format = "%s/%(id)s.%s";
     snprintf(s_dwl_data, sizeof(s_dwl_data), download_data_format, v_resolution, vcodec);
-    snprintf(s_dwl_dir, sizeof(s_dwl_dir), download_dir_format, download_path, DOWNLOAD_VIDEO_PREFERRED_EXT.c_str());
-    snprintf(download_cmd, sizeof(download_cmd),
-             "%s -f \"%s\" \"%s\" -o \"%s\"", YTDLP_BIN_PATH.c_str(), s_dwl_data, video_url, s_dwl_dir);
-    printf("%s\n", download_cmd);
-    system(download_cmd);
+    std::string s_dwl_dir = std::string(download_path) + "/%(id)s." + DOWNLOAD_VIDEO_PREFERRED_EXT;
+    Process_Options options;
+    options.capture_output = false;
+    process_manager.run({ YTDLP_BIN_PATH, "-f", s_dwl_data, video_url, "-o", s_dwl_dir }, nullptr, options);
 }
 
 /**
 * Return a metric abbreviation from a number, for example: 1520
 * = 1.5K, 1.450.000 = 1.4M
 */
-std::string* YtDlp_Helper::get_metric_abbreviation(int number) {
+std::string* YtDlp_Helper::get_metric_abbreviation(long long number) {
     char metric_abbr[32];
     if (number < 1000) {
-        snprintf(metric_abbr, sizeof(metric_abbr), "%d", number );
+        snprintf(metric_abbr, sizeof(metric_abbr), "%lld", number );
     } else if (number < 1000000) {
         snprintf(metric_abbr, sizeof(metric_abbr), "%.1fK", (number/1000.0));
     } else {
@@ -362,10 +1226,12 @@ void YtDlp_Helper::resetSearchHistoryPos() {
 }
 
 const std::string YtDlp_Helper::get_metadata_template() {
+    bool json = (this->metadata_format == YT_METADATA_FORMAT::METADATA_JSON);
     switch (this->metadata_profile) {
         case YT_METADATA_PROFILE::SIMPLE:
-            return YtDlp_Helper::PRINT_SEARCH_METADATA_TEMPLATE;
+            return json ? YtDlp_Helper::PRINT_SEARCH_METADATA_JSON_TEMPLATE : YtDlp_Helper::PRINT_SEARCH_METADATA_TEMPLATE;
         case YT_METADATA_PROFILE::DETAILED:
-            return YtDlp_Helper::PRINT_DETAILED_METADATA_TEMPLATE;
+            return json ? YtDlp_Helper::PRINT_DETAILED_METADATA_JSON_TEMPLATE : YtDlp_Helper::PRINT_DETAILED_METADATA_TEMPLATE;
     }
+    return YtDlp_Helper::PRINT_SEARCH_METADATA_TEMPLATE;
 }
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2025-2026 - FLtube
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License, version 3, as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ */
+
+#include "../include/ytdlp_worker.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
+
+extern char **environ;
+
+const std::string YtDlp_Worker::PYTHON_INTERPRETER = "python3";
+
+/* Source of the worker loop run by @PYTHON_INTERPRETER. The release binary of yt-dlp is a zipapp, so if @ytdlp_path
+ * points to a zip file it is added to sys.path in order to import the "yt_dlp" module from it. */
+static const char* WORKER_SOURCE = R"PY(
+import os, shutil, signal, sys, zipfile
+ytdlp_path = sys.argv[1] if len(sys.argv) > 1 else 'yt-dlp'
+candidate = ytdlp_path if os.path.sep in ytdlp_path else shutil.which(ytdlp_path)
+if candidate and zipfile.is_zipfile(candidate):
+    sys.path.insert(0, candidate)
+out = sys.stdout
+try:
+    import yt_dlp
+    from yt_dlp.version import __version__
+except BaseException as e:
+    out.write('\x1eFLTUBE_FAILED %s\n' % str(e).replace('\n', ' '))
+    out.flush()
+    sys.exit(1)
+# A SIGINT cancels the running request only: it's ignored while waiting for a request or writing its end.
+signal.signal(signal.SIGINT, signal.SIG_IGN)
+out.write('\x1eFLTUBE_READY %s\n' % __version__)
+out.flush()
+while True:
+    line = sys.stdin.readline()
+    if not line:
+        break
+    fields = line.rstrip('\n').split('\x1f')
+    status = 130
+    try:
+        try:
+            signal.signal(signal.SIGINT, signal.default_int_handler)
+            out.write('\x1eFLTUBE_STARTED %s\n' % fields[0])
+            out.flush()
+            yt_dlp.main(fields[1:])
+            status = 0
+        except SystemExit as e:
+            status = e.code if isinstance(e.code, int) else (0 if e.code is None else 1)
+        except KeyboardInterrupt:
+            status = 130
+        except BaseException as e:
+            sys.stderr.write('FLTube worker: %s\n' % e)
+            status = 1
+        finally:
+            signal.signal(signal.SIGINT, signal.SIG_IGN)
+    except KeyboardInterrupt:
+        pass
+    while True:
+        try:
+            signal.signal(signal.SIGINT, signal.SIG_IGN)
+            break
+        except KeyboardInterrupt:
+            pass
+    out.write('\x1eFLTUBE_END %s %d\n' % (fields[0], status))
+    out.flush()
+)PY";
+
+bool YtDlp_Worker::start() {
+    if (is_running()) return true;
+    int in_pipe[2], out_pipe[2];
+    if (pipe2(in_pipe, O_CLOEXEC) != 0) return false;
+    if (pipe2(out_pipe, O_CLOEXEC) != 0) {
+        close(in_pipe[0]); close(in_pipe[1]);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, errors_log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+
+    // The worker must not inherit the SIGPIPE disposition of this process.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    std::vector<char*> argv = { const_cast<char*>(PYTHON_INTERPRETER.c_str()), const_cast<char*>("-u"), const_cast<char*>("-c"),
+        const_cast<char*>(WORKER_SOURCE), const_cast<char*>(ytdlp_path.c_str()), nullptr };
+    int spawn_result = posix_spawnp(&pid, PYTHON_INTERPRETER.c_str(), &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+
+    if (spawn_result != 0) {
+        close(in_pipe[1]); close(out_pipe[0]);
+        pid = -1;
+        logger->warn(_("Cannot start a persistent yt-dlp worker: ") + std::string(strerror(spawn_result)));
+        return false;
+    }
+    to_worker_fd = in_pipe[1];
+    from_worker_fd = out_pipe[0];
+    ready = false;
+    pending_output.clear();
+    logger->debug("Persistent yt-dlp worker started with PID " + std::to_string(pid));
+    return true;
+}
+
+void YtDlp_Worker::stop() {
+    if (!is_running()) return;
+    // Closing the worker stdin ends its request loop...
+    close(to_worker_fd);
+    to_worker_fd = -1;
+    reap();
+}
+
+void YtDlp_Worker::reap() {
+    if (to_worker_fd >= 0) close(to_worker_fd);
+    if (from_worker_fd >= 0) close(from_worker_fd);
+    to_worker_fd = from_worker_fd = -1;
+    if (pid > 0) {
+        int status;
+        if (waitpid(pid, &status, WNOHANG) == 0) {
+            kill(pid, SIGTERM);
+            waitpid(pid, &status, 0);
+        }
+    }
+    pid = -1;
+    ready = false;
+    pending_output.clear();
+}
+
+bool YtDlp_Worker::read_line(std::string& line) {
+    char buffer[4 * 1024];
+    size_t eol;
+    while ((eol = pending_output.find('\n')) == std::string::npos) {
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            struct pollfd pfd = { from_worker_fd, POLLIN, 0 };
+            if (remaining <= 0 || poll(&pfd, 1, remaining) == 0) {
+                deadline_exceeded = true;
+                return false;
+            }
+        }
+        ssize_t count = read(from_worker_fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return false;
+        pending_output.append(buffer, count);
+    }
+    line.assign(pending_output, 0, eol);
+    pending_output.erase(0, eol + 1);
+    return true;
+}
+
+bool YtDlp_Worker::wait_until_ready() {
+    if (ready) return true;
+    std::string line;
+    while (read_line(line)) {
+        if (line.empty() || line[0] != RECORD_MARK) continue;
+        if (line.compare(1, 12, "FLTUBE_READY") == 0) {
+            logger->debug("Persistent yt-dlp worker is ready (yt-dlp version " + line.substr(std::min<size_t>(14, line.size())) + ").");
+            ready = true;
+            return true;
+        }
+        if (line.compare(1, 13, "FLTUBE_FAILED") == 0) {
+            logger->warn(_("The persistent yt-dlp worker cannot import yt-dlp: ") + line.substr(std::min<size_t>(15, line.size())));
+            break;
+        }
+    }
+    return false;
+}
+
+YTDLP_WORKER_RESULT YtDlp_Worker::request(const std::vector<std::string>& args, const ytdlp_line_handler& on_line, int& exit_status,
+                                          Cancellation_Token* token, unsigned int timeout_ms) {
+    exit_status = -1;
+    deadline_exceeded = false;
+    deadline = (timeout_ms > 0) ? std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms)
+                                : std::chrono::steady_clock::time_point::max();
+    for (const std::string& arg: args) {
+        if (arg.find_first_of(std::string("\n") + FIELD_SEPARATOR) != std::string::npos) return WRK_REJECTED;
+    }
+    if (!is_running() || !wait_until_ready()) {
+        reap();
+        return deadline_exceeded ? WRK_TIMEOUT : WRK_CRASHED;
+    }
+
+    std::string request_id = std::to_string(++last_request_id);
+    std::string frame = request_id;
+    for (const std::string& arg: args) {
+        frame += FIELD_SEPARATOR;
+        frame += arg;
+    }
+    frame += '\n';
+    size_t written = 0;
+    while (written < frame.size()) {
+        ssize_t count = write(to_worker_fd, frame.data() + written, frame.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            reap();
+            return WRK_CRASHED;
+        }
+        written += count;
+    }
+
+    std::string line;
+    std::string started_mark = std::string(1, RECORD_MARK) + "FLTUBE_STARTED " + request_id;
+    std::string end_mark = std::string(1, RECORD_MARK) + "FLTUBE_END " + request_id + " ";
+    while (read_line(line)) {
+        if (line == started_mark) {
+            // yt-dlp turns a SIGINT into an "Interrupted by user" exit, and then the worker waits for the next request.
+            // The worker ignores a SIGINT until it prints this line, so a cancellation is not delivered before.
+            if (token != nullptr && !token->attach(pid, SIGINT)) kill(pid, SIGINT);
+            continue;
+        }
+        if (line.compare(0, end_mark.size(), end_mark) == 0) {
+            try {
+                exit_status = std::stoi(line.substr(end_mark.size()));
+            } catch (const std::exception& e) {
+                exit_status = -1;
+            }
+            if (token != nullptr) token->detach(pid);
+            return WRK_OK;
+        }
+        on_line(line);
+    }
+    // The worker closed its stdout before finishing the request, or it's hung...
+    if (token != nullptr) token->detach(pid);
+    reap();
+    if (deadline_exceeded) {
+        logger->warn(_("A yt-dlp request exceeded its time limit, so its persistent worker was terminated."));
+        return WRK_TIMEOUT;
+    }
+    return WRK_CRASHED;
+}
+
+YtDlp_Worker_Pool::YtDlp_Worker_Pool(unsigned int count, std::string ytdlp_path, std::string errors_log_path, std::shared_ptr<TerminalLogger> const& lgg):
+    logger(lgg), consecutive_crashes(0), enabled(true) {
+    // Writing to a crashed worker must return an error instead of killing FLTube with a SIGPIPE.
+    signal(SIGPIPE, SIG_IGN);
+    if (count > MAX_WORKERS) count = MAX_WORKERS;
+    for (unsigned int i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<YtDlp_Worker>(ytdlp_path, errors_log_path, lgg));
+        busy.push_back(false);
+        // Spawn now, so the yt_dlp import runs in parallel with the application startup.
+        workers.back()->start();
+    }
+    if (workers.empty()) enabled = false;
+}
+
+YtDlp_Worker_Pool::~YtDlp_Worker_Pool() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    for (auto& worker: workers) worker->stop();
+}
+
+int YtDlp_Worker_Pool::acquire() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (!enabled) return -1;
+    for (int i = 0; i < (int)workers.size(); i++) {
+        if (!busy[i]) {
+            busy[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void YtDlp_Worker_Pool::release(int index) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    busy[index] = false;
+}
+
+bool YtDlp_Worker_Pool::run(const std::vector<std::string>& args, const ytdlp_line_handler& on_line, int& exit_status, Cancellation_Token* token,
+                            unsigned int timeout_ms) {
+    int index = acquire();
+    if (index < 0) return false;
+    YtDlp_Worker* worker = workers[index].get();
+
+    bool served = false;
+    bool output_received = false;
+    auto track_output = [&](const std::string& line) {
+        output_received = true;
+        on_line(line);
+    };
+    // The first attempt plus one retry over a restarted worker, unless some output was already delivered.
+    for (int attempt = 0; attempt < 2 && !served; attempt++) {
+        if (!worker->is_running() && !worker->start()) break;
+        YTDLP_WORKER_RESULT result = worker->request(args, track_output, exit_status, token, timeout_ms);
+        if (result == WRK_REJECTED) break;
+        if (result == WRK_TIMEOUT) {
+            // Retrying (or falling back to a new process) would probably hang again.
+            served = true;
+            break;
+        }
+        if (result == WRK_OK) {
+            served = true;
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            consecutive_crashes = 0;
+        } else if (token != nullptr && token->is_cancelled()) {
+            // Killed by the cancellation (i.e. before it could handle the SIGINT): not a crash of the worker.
+            break;
+        } else {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            consecutive_crashes++;
+            logger->warn(_("A persistent yt-dlp worker crashed. Restarting it..."));
+            if (consecutive_crashes >= MAX_CONSECUTIVE_CRASHES) {
+                enabled = false;
+                logger->warn(_("Persistent yt-dlp workers were disabled after several crashes. Falling back to one yt-dlp process per call."));
+                break;
+            }
+            if (output_received) break;
+        }
+    }
+    release(index);
+    return served;
+}